@@ -1,6 +1,14 @@
 #pragma once
 
 #include "Filesystem.hpp"
+#include "ContigTable.hpp"
+#include "PafRecord.hpp"
+#include "ReadNameTable.hpp"
+#include "ChainStore.hpp"
+#include "ChainPartitions.hpp"
+#include "AlignmentSource.hpp"
+#include "Region.hpp"
+#include "Bam.hpp"
 #include <ostream>
 #include <vector>
 #include <string>
@@ -8,6 +16,7 @@
 #include <set>
 #include <list>
 #include <map>
+#include <functional>
 
 using ghc::filesystem::create_directories;
 using ghc::filesystem::path;
@@ -18,52 +27,17 @@ using std::pair;
 using std::set;
 using std::list;
 using std::map;
+using std::function;
 
 namespace liger2liger{
 
-class ChainElement {
-public:
-    string ref_name;
-    uint32_t ref_start;
-    uint32_t ref_stop;
-    uint32_t query_start;
-    uint32_t query_stop;
-    uint32_t ref_length;
-    uint32_t query_length;
-    uint32_t residue_matches;
-    uint32_t alignment_length;
-    uint32_t map_quality;
-    bool is_reverse;
-
-    /// Methods ///
-    ChainElement(
-        const string& ref_name,
-        uint32_t ref_start,
-        uint32_t ref_stop,
-        uint32_t query_start,
-        uint32_t query_stop,
-        uint32_t ref_length,
-        uint32_t query_length,
-        uint32_t residue_matches,
-        uint32_t alignment_length,
-        uint32_t mapping_quality,
-        bool is_reverse);
-
-    uint32_t distance_to_end_of_contig() const;
-    uint32_t get_forward_start() const;
-    uint32_t get_forward_stop() const;
-
-    ChainElement()=default;
-};
-
-
-ostream& operator<<(ostream& o, const ChainElement& e);
-
-
+/// One read's alignments, which are a contiguous range of the ChainStore that owns them
 class AlignmentChain {
-public:
-    vector <ChainElement> chain;
+    ChainStore* store;
+    size_t offset;
+    size_t length;
 
+public:
     // Break chains using this threshold for the largest gep between alignments
     static const uint32_t max_gap = 50000;
 
@@ -71,24 +45,62 @@ public:
     static const uint32_t gap_penalty = 5000;
 
     /// Methods ///
-    AlignmentChain()=default;
-    void add(ChainElement& e);
+    AlignmentChain(ChainStore& store, size_t offset, size_t length);
+    ChainElement operator[](size_t i) const;
     void sort_chain();
-    void split(set <pair <size_t, size_t> >& subchain_bounds, pair <size_t, size_t> bounds = {0,0});
-    uint32_t compute_distance(ChainElement& a, ChainElement& b);
+
+    /// Same as above, also filling order with the original position of each element, in sorted order
+    void sort_chain(vector<uint32_t>& order);
+    void split(vector <pair <size_t, size_t> >& subchain_bounds) const;
+
+    /// Same as above, with the gaps of the whole store already computed by AlignmentChains::compute_gaps
+    void split(const vector<uint32_t>& store_gaps, vector <pair <size_t, size_t> >& subchain_bounds) const;
+    void compute_gaps(vector<uint32_t>& gaps) const;
+
+    /// Same as above, with contig_penalty in place of gap_penalty
+    void compute_gaps(vector<uint32_t>& gaps, uint32_t contig_penalty) const;
+    uint32_t compute_distance(size_t a, size_t b) const;
+
+    /// Same as above, with contig_penalty in place of gap_penalty
+    uint32_t compute_distance(size_t a, size_t b, uint32_t contig_penalty) const;
     size_t size() const;
+
+private:
+    void split_at_gaps(const uint32_t* gaps, vector <pair <size_t, size_t> >& subchain_bounds) const;
 };
 
 
 void print_subchains(
         const AlignmentChain& chain,
-        const set <pair <size_t, size_t> >& subchain_bounds,
-        const string& read_name);
+        const vector <pair <size_t, size_t> >& subchain_bounds,
+        string_view read_name);
+
+
+/// Order in which AlignmentChains::for_each_chain visits reads
+enum class ReadOrder {
+    by_name,
+    first_seen
+};
 
 
 class AlignmentChains {
+    // Number of run files that for_read_in_bam spills to, and again for each partition that is too large to load
+    static const size_t n_spill_partitions = 64;
+
+    // Estimate of the memory that a partition takes once loaded and grouped, per byte that it takes on disk
+    static const size_t bytes_per_spilled_byte = 2;
+
+    void for_read_in_partitions(
+            ChainPartitions& partitions,
+            size_t max_memory,
+            const function<void(string_view name, AlignmentChain& chain)>& f);
+
 public:
-    map <string, AlignmentChain> chains;
+    ReadNameTable read_names;
+
+    // Alignments of every read, tagged with the read's id in read_names
+    ChainStore elements;
+    ContigTable contigs;
 
     // Ignore alignments with mapQ score less than this
     static const uint32_t min_quality = 5;
@@ -98,10 +110,82 @@ public:
 
     /// Methods ///
     AlignmentChains()=default;
-    void add_alignment(string line);
+    void add(string_view read_name, const ChainElement& e);
+
+    /// Whether an alignment is kept, by its map quality, which applies equally to every input format
+    static bool is_usable(const ChainElement& e);
+
+    /// Add the usable alignments of any source in AlignmentSource.hpp, a batch at a time. Instantiated for each type of
+    /// source, so that no callback is made per alignment.
+    template<class Source> void load(Source& source);
+    AlignmentChain get_chain(uint32_t read_id);
+    void for_each_chain(const function<void(string_view read_name, AlignmentChain& chain)>& f, ReadOrder order=ReadOrder::by_name);
+    void add_alignment(string_view line);
+    void add_alignment(const PafRecord& record);
     void load_from_paf(path paf_path);
-    void load_from_bam(path bam_path);
+    void load_from_paf_mmap(path paf_path);
+    void load_from_paf_parallel(path paf_path, size_t n_threads);
+    void load_from_paf_buffer(string_view buffer);
+    void merge(AlignmentChains& other);
+    void load_from_compressed_paf(path paf_path, size_t n_threads);
+    void for_read_in_paf(path paf_path, size_t n_threads, const function<void(string_view name, AlignmentChain& chain)>& f);
+    void load_from_bam(path bam_path, size_t n_threads=1);
+    void load_from_bam(
+            path bam_path,
+            size_t n_threads,
+            const vector<Region>& regions,
+            bool include_linked,
+            path reference_path="");
+    void for_element_in_bam(
+            path bam_path,
+            size_t n_threads,
+            const vector<Region>& regions,
+            bool include_linked,
+            path reference_path,
+            const function<void(string_view read_name, const ChainElement& e)>& f);
+    void for_read_in_bam(
+            path bam_path,
+            size_t n_threads,
+            const vector<Region>& regions,
+            bool include_linked,
+            path reference_path,
+            size_t max_memory,
+            path temp_directory,
+            const function<void(string_view name, AlignmentChain& chain)>& f);
+    void for_read_in_grouped_bam(
+            Bam& reader,
+            const function<void(
+                    string_view name,
+                    AlignmentChain& chain,
+                    const BamRecordBatch& records,
+                    const vector<uint32_t>& record_indexes)>& f);
+    void for_read_in_bam_primary(
+            path bam_path,
+            size_t n_threads,
+            path reference_path,
+            const function<void(string_view name, AlignmentChain& chain)>& f);
+    void load_from_sam(path sam_path, size_t n_threads=1);
+    void for_read_in_sam_primary(
+            path sam_path,
+            size_t n_threads,
+            const function<void(string_view name, AlignmentChain& chain)>& f);
     void split_all_chains();
+
+    /// Gaps between neighbouring elements of every chain, indexed like the store, for AlignmentChain::split
+    void compute_gaps(vector<uint32_t>& gaps);
 };
 
+
+template<class Source> void AlignmentChains::load(Source& source) {
+    AlignmentBatch batch;
+
+    while (source.next_batch(batch, contigs)) {
+        for (size_t i=0; i<batch.size(); i++) {
+            if (is_usable(batch.elements[i])) {
+                add(batch.get_name(i), batch.elements[i]);
+            }
+        }
+    }
+}
+
 }
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "BgzfLineReader.hpp"
+#include "BoundedQueue.hpp"
+#include "ChainElement.hpp"
+#include "ContigTable.hpp"
+#include "PafRecord.hpp"
+#include "Filesystem.hpp"
+#include "Bam.hpp"
+#include "Sam.hpp"
+
+#include <string_view>
+#include <exception>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+
+using ghc::filesystem::path;
+using std::exception_ptr;
+using std::string_view;
+using std::string;
+using std::vector;
+using std::thread;
+
+namespace liger2liger{
+
+
+/// Chain elements converted by an AlignmentSource, with the name of each element's read packed into one string
+class AlignmentBatch {
+public:
+    vector<ChainElement> elements;
+    string names;
+
+    // End of each element's name in names, which is where the next one starts
+    vector<size_t> name_stops;
+
+    void add(string_view name, const ChainElement& e);
+    string_view get_name(size_t i) const;
+    size_t size() const;
+    void clear();
+};
+
+
+/// Every input format is read through a source class with the same interface, which AlignmentChains::load and the
+/// classification in filter_chimeras_from_alignment are templated on:
+///
+///     bool next_batch(AlignmentBatch& batch, ContigTable& contigs);
+///
+/// which replaces the contents of batch with the next alignments of the input, in input order, converted to chain
+/// elements whose contig ids come from contigs. Returns false once the input is exhausted. Sources only convert, so the
+/// alignments that are kept is decided in one place, by AlignmentChains::is_usable, whatever the format. The readers
+/// that can't be a source, because they group reads as they stream or only read regions, convert with the same
+/// functions as the source of their format, and filter with is_usable too.
+
+
+/// Alignment spans from the operations of a CIGAR, with the same accounting as paftools.js sam2paf, where the first clip
+/// is the start clip and any later one the end
+class CigarSpans {
+public:
+    uint32_t start_clip = 0;
+    uint32_t end_clip = 0;
+    uint32_t n_matches = 0;
+    uint32_t n_inserts = 0;
+    uint32_t n_deletes = 0;
+
+    void add(uint32_t op, uint32_t length, bool is_first);
+
+    /// Add every operation of a text CIGAR, as in SAM or an SA tag. Returns false if it can't be parsed.
+    bool add(string_view cigar);
+
+    /// Add every operation of a BAM record's CIGAR, read in place
+    void add(const bam1_t* record);
+
+    ChainElement get_element(
+            uint32_t contig_id,
+            uint32_t ref_start,
+            uint32_t ref_length,
+            uint32_t map_quality,
+            bool is_reverse) const;
+};
+
+
+/// Contig id of each BAM target id, filled on first use so that ids stay in order of first appearance
+class TargetContigIds {
+    vector<uint32_t> contig_ids;
+    uint32_t unmapped_contig_id = UINT32_MAX;
+
+public:
+    uint32_t get_id(int32_t tid, const bam_hdr_t* header, ContigTable& contigs);
+    static uint32_t get_length(int32_t tid, const bam_hdr_t* header);
+
+    /// Element of a BAM record, computed from its CIGAR without copying any of its fields
+    ChainElement get_element(const bam1_t* record, const bam_hdr_t* header, ContigTable& contigs);
+};
+
+
+/// Element of an entry of an SA tag, from BAM or SAM, which each look up the entry's contig in their own way
+ChainElement get_sa_element(string_view read_name, const SaEntry& entry, uint32_t contig_id, uint32_t ref_length);
+
+
+/// Plain, gzip or BGZF PAF, or stdin if the path is "-"
+class PafSource {
+    BgzfLineReader file;
+    PafRecord record;
+
+public:
+    PafSource(path paf_path, size_t n_threads=1);
+    bool next_batch(AlignmentBatch& batch, ContigTable& contigs);
+
+    /// Element of a record, or false if it fails the cm:i: tag filter. Only PAF has that tag, so every PAF reader
+    /// filters by it here, before AlignmentChains::is_usable.
+    static bool get_element(const PafRecord& record, ContigTable& contigs, ChainElement& e);
+};
+
+
+/// PAF that is already in memory, such as a MappedFile or a range of one, parsed in place
+class PafBufferSource {
+    string_view buffer;
+    PafRecord record;
+
+public:
+    explicit PafBufferSource(string_view buffer);
+    bool next_batch(AlignmentBatch& batch, ContigTable& contigs);
+};
+
+
+/// Plain, gzip or BGZF SAM text, or stdin if the path is "-", with spans computed from the CIGAR text
+class SamSource {
+    SamReader reader;
+    SamRecord record;
+
+public:
+    SamSource(path sam_path, size_t n_threads=1);
+    bool next_batch(AlignmentBatch& batch, ContigTable& contigs);
+
+    /// Element of a record, of which reader has parsed the header
+    static ChainElement get_element(const SamRecord& record, const SamReader& reader, ContigTable& contigs);
+};
+
+
+/// Every record of a BAM or CRAM, decompressed on n_threads. With any n_workers, those convert batches of records on a
+/// pipeline that runs ahead of next_batch on its own thread.
+class BamSource {
+    // Converting threads of the pipeline, or 0 if records are converted by next_batch as they are read
+    size_t n_workers;
+
+    Bam reader;
+    TargetContigIds target_contig_ids;
+
+    // Batches converted by the pipeline, in input order, holding the target id of each element in place of its contig
+    // id, since the contig table may only be used by the thread that calls next_batch
+    BoundedQueue<AlignmentBatch> converted_batches;
+    thread pipeline;
+    exception_ptr pipeline_exception;
+
+    void convert_batches();
+
+public:
+    BamSource(path bam_path, size_t n_threads=1, path reference_path="", size_t n_workers=0);
+    ~BamSource();
+
+    BamSource(const BamSource& other)=delete;
+    BamSource& operator=(const BamSource& other)=delete;
+
+    bool next_batch(AlignmentBatch& batch, ContigTable& contigs);
+};
+
+
+}
@@ -3,32 +3,144 @@
 #include "htslib/include/htslib/hts.h"
 #include "htslib/include/htslib/sam.h"
 #include "Filesystem.hpp"
+#include "Region.hpp"
 #include "Sam.hpp"
 
 using ghc::filesystem::path;
 
+#include <unordered_set>
 #include <functional>
+#include <utility>
 #include <string>
+#include <vector>
+#include <map>
 
+using std::unordered_set;
 using std::function;
 using std::string;
+using std::vector;
+using std::pair;
+using std::map;
 
 namespace liger2liger{
 
+
+/// Reference position as htslib takes it, which is hts_pos_t from htslib 1.10 on, and int before that
+#ifdef HTS_POS_MAX
+using HtsPosition = hts_pos_t;
+#else
+using HtsPosition = int;
+#endif
+
+
+/// One of the other alignments of a read, as listed in the SA:Z tag of each of its records
+class SaEntry {
+public:
+    string ref_name;
+
+    // 0-based, unlike the tag itself
+    int64_t ref_start;
+    bool is_reverse;
+    string_view cigar;
+    uint8_t map_quality;
+    uint32_t edit_distance;
+};
+
+
+/// Parse the value of an SA tag, calling f for each entry. Malformed entries are skipped. The entry is reused between calls.
+void for_sa_entry(string_view sa_tag, const function<void(const SaEntry& entry)>& f);
+
+
+/// Records decoded ahead by Bam::for_record_batch_in_bam. The records belong to the reader's pool, and are reused for
+/// another batch once the batch has been handled.
+class BamRecordBatch {
+public:
+    vector<bam1_t*> records;
+
+    // Number of records filled, which is only less than records.size() for the last batch
+    size_t size;
+
+    // Position of the batch in the input, counting from 0
+    size_t index;
+};
+
+
 class Bam {
     path bam_path;
 
+    // Kept to open the file again, for a second pass
+    path reference_path;
+    size_t n_threads;
+
     samFile* bam_file;
     bam_hdr_t* bam_header;
-//    hts_idx_t* bam_index;
+    hts_idx_t* bam_index;
     hts_itr_t* bam_iterator;
     bam1_t* alignment;
 
+    // Decompresses BGZF blocks ahead of the reader. Only started for more than 1 thread.
+    htsThreadPool thread_pool;
+
+    bool is_cram;
+
+    /// Free whatever has been opened, which may be only part of it if the constructor failed
+    void close();
+    void set_cram_required_fields(int fields);
+    void load_index();
+    void for_record_in_interval(int32_t tid, int64_t start, int64_t stop, const function<void()>& f);
+    void add_linked_positions(map<pair<int32_t, int64_t>, unordered_set<string> >& linked) const;
+
 public:
-    Bam(path bam_path);
+    /// Also opens CRAM, which is decoded from the reference at reference_path if given, or else from wherever its
+    /// header points. Only the fields that chains are built from are decoded.
+    Bam(path bam_path, size_t n_threads=1, path reference_path="");
     ~Bam();
     void for_alignment_in_bam(const function<void(const string& ref_name, const string& query_name, int32_t query_length, uint8_t map_quality, uint16_t flag)>& f);
     void for_alignment_in_bam(bool get_cigar, const function<void(SamElement& alignment)>& f);
+
+    /// Visit each record in the reused bam1_t, without copying any of its fields
+    void for_record_in_bam(const function<void(const bam1_t* record, const bam_hdr_t* header)>& f);
+
+    /// Read the next record into the reused bam1_t, returning nullptr at EOF. The record is only valid until the next call.
+    const bam1_t* next_record();
+
+    /// Decode records on a reader thread into batches drawn from a fixed pool of bam1_t, and hand each full batch over a
+    /// bounded queue to one of n_workers threads, which call f on it. Batches go back to the pool when f returns, so
+    /// records are only allocated once, and the reader waits when the workers fall behind. f is called concurrently, and
+    /// batches may finish out of order, which their index allows the caller to undo.
+    void for_record_batch_in_bam(
+            size_t n_workers,
+            const function<void(const BamRecordBatch& batch, const bam_hdr_t* header)>& f);
+
+    /// Visit the records of each read together, for input in which they are adjacent, such as BAM sorted by name. The
+    /// records are reused for later reads. Throws if a read's records turn out not to be adjacent. Closed reads are
+    /// tracked by name hash, so for a file a repeat is confirmed by reading the names again when it is found, and for
+    /// stdin it may rarely be a hash collision, as described in ReadGroupFilter.
+    void for_read_in_bam(const function<void(const BamRecordBatch& records, const bam_hdr_t* header)>& f);
+
+    const bam_hdr_t* get_header() const;
+
+    /// Decode every field of CRAM records, instead of just those that chains need, so that they can be written out whole
+    void require_all_fields();
+
+    /// Pool that decompresses this file, which can be shared with a BamWriter, or nullptr if there is none
+    htsThreadPool* get_thread_pool();
+
+    /// Visit only primary records, skipping secondary and supplementary ones from their flag alone. Each primary record
+    /// lists the read's supplementary alignments in its SA tag, so chains can be built without the skipped records.
+    void for_primary_record_in_bam(const function<void(const bam1_t* record, const bam_hdr_t* header)>& f);
+
+    /// Parse the SA tag of a record, if it has one
+    static void for_sa_entry(const bam1_t* record, const function<void(const SaEntry& entry)>& f);
+
+    /// Visit only the records that overlap the regions, decompressing just the BGZF blocks that the index points to. A
+    /// record that overlaps several regions is visited once. With include_linked, the supplementary alignments (from
+    /// SA tags) and mates of those records are visited too, wherever they are. Requires a .bai, .csi or .crai index.
+    void for_record_in_regions(
+            const vector<Region>& regions,
+            bool include_linked,
+            const function<void(const bam1_t* record, const bam_hdr_t* header)>& f);
+
     static bool is_first_mate(uint16_t flag);
     static bool is_second_mate(uint16_t flag);
     static bool is_not_primary(uint16_t flag);
@@ -36,5 +148,24 @@ public:
     static bool is_supplementary(uint16_t flag);
 };
 
+
+/// BAM output with the header of an input, compressed by the input's thread pool if it has one. Must be destroyed
+/// before that input, since it uses the pool until its last block has been written when it is closed.
+class BamWriter {
+    path bam_path;
+    samFile* bam_file;
+    const bam_hdr_t* bam_header;
+
+public:
+    BamWriter(path bam_path, Bam& input);
+    ~BamWriter();
+
+    BamWriter(const BamWriter& other)=delete;
+    BamWriter& operator=(const BamWriter& other)=delete;
+
+    void write(const bam1_t* record);
+};
+
+
 }
 
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "htslib/include/htslib/bgzf.h"
+#include "htslib/include/htslib/kstring.h"
+#include "Filesystem.hpp"
+
+#include <string_view>
+
+using ghc::filesystem::path;
+using std::string_view;
+
+namespace liger2liger{
+
+
+/// Line reader for plain text, gzip or BGZF files, or stdin if the path is "-". BGZF blocks are decompressed by a pool
+/// of n_threads, while plain gzip can only be inflated as a single stream.
+class BgzfLineReader {
+    path file_path;
+    BGZF* file;
+    kstring_t line;
+
+public:
+    BgzfLineReader(path file_path, size_t n_threads);
+    ~BgzfLineReader();
+
+    BgzfLineReader(const BgzfLineReader& other)=delete;
+    BgzfLineReader& operator=(const BgzfLineReader& other)=delete;
+
+    /// Read the next line, without its newline. The view is only valid until the next call. Returns false at EOF.
+    bool next_line(string_view& result);
+};
+
+
+/// True if this path has to be read as a stream instead of memory mapped
+bool is_stream_path(path file_path);
+
+
+}
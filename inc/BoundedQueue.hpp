@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <deque>
+
+using std::condition_variable;
+using std::unique_lock;
+using std::mutex;
+using std::deque;
+
+namespace liger2liger{
+
+
+/// Blocking FIFO for handing work between threads. push waits while the queue is full, and pop waits while it is empty.
+/// Once closed, push fails, and pop fails as soon as the queue is empty, so consumers drain what is left and stop.
+template<class T> class BoundedQueue {
+    deque<T> items;
+    size_t capacity;
+    bool is_closed;
+
+    mutex items_mutex;
+    condition_variable not_empty;
+    condition_variable not_full;
+
+public:
+    explicit BoundedQueue(size_t capacity);
+
+    bool push(T item);
+    bool pop(T& item);
+    void close();
+};
+
+
+template<class T> BoundedQueue<T>::BoundedQueue(size_t capacity):
+    capacity(capacity),
+    is_closed(false)
+{}
+
+
+template<class T> bool BoundedQueue<T>::push(T item){
+    unique_lock<mutex> lock(items_mutex);
+
+    not_full.wait(lock, [&](){
+        return is_closed or items.size() < capacity;
+    });
+
+    if (is_closed) {
+        return false;
+    }
+
+    items.emplace_back(std::move(item));
+    lock.unlock();
+    not_empty.notify_one();
+
+    return true;
+}
+
+
+template<class T> bool BoundedQueue<T>::pop(T& item){
+    unique_lock<mutex> lock(items_mutex);
+
+    not_empty.wait(lock, [&](){
+        return is_closed or not items.empty();
+    });
+
+    if (items.empty()) {
+        return false;
+    }
+
+    item = std::move(items.front());
+    items.pop_front();
+    lock.unlock();
+    not_full.notify_one();
+
+    return true;
+}
+
+
+template<class T> void BoundedQueue<T>::close(){
+    {
+        unique_lock<mutex> lock(items_mutex);
+        is_closed = true;
+    }
+
+    not_empty.notify_all();
+    not_full.notify_all();
+}
+
+
+}
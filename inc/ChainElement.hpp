@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+using std::ostream;
+
+namespace liger2liger{
+
+
+class ChainElement {
+public:
+    // Index of the reference contig in the ContigTable of the AlignmentChains that this element belongs to
+    uint32_t contig_id;
+    uint32_t ref_start;
+    uint32_t ref_stop;
+    uint32_t query_start;
+    uint32_t query_stop;
+    uint32_t ref_length;
+    uint32_t query_length;
+    uint32_t residue_matches;
+    uint32_t alignment_length;
+    uint32_t map_quality;
+    bool is_reverse;
+
+    /// Methods ///
+    ChainElement(
+        uint32_t contig_id,
+        uint32_t ref_start,
+        uint32_t ref_stop,
+        uint32_t query_start,
+        uint32_t query_stop,
+        uint32_t ref_length,
+        uint32_t query_length,
+        uint32_t residue_matches,
+        uint32_t alignment_length,
+        uint32_t mapping_quality,
+        bool is_reverse);
+
+    uint32_t distance_to_end_of_contig() const;
+    uint32_t get_forward_start() const;
+    uint32_t get_forward_stop() const;
+
+    ChainElement()=default;
+};
+
+
+ostream& operator<<(ostream& o, const ChainElement& e);
+
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ChainElement.hpp"
+#include "Filesystem.hpp"
+
+#include <string_view>
+#include <functional>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using ghc::filesystem::path;
+using std::string_view;
+using std::function;
+using std::string;
+using std::vector;
+
+namespace liger2liger{
+
+
+/// Chain elements spilled to run files on disk, partitioned by a hash of their read name, so that all alignments of a
+/// read land in the same partition wherever they are in the input. Each partition can then be loaded and grouped on its
+/// own. Records are buffered in memory until the buffers reach max_buffered_bytes, and then appended to their files.
+class ChainPartitions {
+    path directory;
+    uint64_t seed;
+    size_t max_buffered_bytes;
+    size_t n_buffered_bytes;
+
+    vector<path> partition_paths;
+    vector<string> buffers;
+    vector<uint64_t> partition_sizes;
+
+    // Hash of the first read in each partition, and whether any other read has been added since, which tells whether
+    // splitting the partition again could make it smaller
+    vector<uint64_t> first_read_hashes;
+    vector<uint8_t> has_several_reads;
+
+    void flush(size_t partition);
+
+public:
+    /// Run files are created in a new directory named directory_prefix with a unique suffix, which is removed with them on
+    /// destruction. Partitions made with different seeds split the same reads independently.
+    ChainPartitions(path directory_prefix, size_t n_partitions, size_t max_buffered_bytes, uint64_t seed=0);
+    ~ChainPartitions();
+
+    ChainPartitions(const ChainPartitions& other)=delete;
+    ChainPartitions& operator=(const ChainPartitions& other)=delete;
+
+    void add(string_view read_name, const ChainElement& e);
+
+    /// Write every buffer to its file. Must be called after the last add, before reading any partition.
+    void flush();
+
+    /// Visit the elements of one partition in the order they were added, reading its file in fixed size blocks
+    void for_element_in_partition(
+            size_t partition,
+            const function<void(string_view read_name, const ChainElement& e)>& f) const;
+
+    /// Delete the file of a partition that is no longer needed
+    void remove(size_t partition);
+
+    /// Bytes that a partition takes on disk, which is roughly what it takes once loaded
+    uint64_t get_partition_size(size_t partition) const;
+    bool is_splittable(size_t partition) const;
+    uint64_t get_seed() const;
+    path get_directory() const;
+    size_t size() const;
+};
+
+
+}
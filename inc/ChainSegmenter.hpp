@@ -0,0 +1,75 @@
+#pragma once
+
+#include "AlignmentChain.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <deque>
+
+using std::vector;
+using std::deque;
+using std::pair;
+
+namespace liger2liger{
+
+
+/// Costs that ChainSegmenter weighs against each other to decide where a chain is split. At their defaults, every split
+/// that AlignmentChain::split makes has a lower cost than joining, and no other split does, so both give the same
+/// subchains.
+class SegmentationCosts {
+public:
+    // Cost of each subchain beyond the first, which a gap has to exceed to be worth splitting at
+    uint32_t split_cost = AlignmentChain::max_gap;
+
+    // Added to the distance between neighbouring alignments that are on different contigs
+    uint32_t contig_jump_cost = AlignmentChain::gap_penalty;
+
+    // Cost of neighbouring alignments being on opposite strands, as in a palindrome
+    uint32_t strand_flip_cost = 0;
+
+    // Cost per base of the read that neighbouring alignments both cover, which one molecule should only explain once
+    uint32_t overlap_cost = 0;
+
+    // Subchains with fewer aligned bases of the read than this also cost short_segment_cost
+    uint32_t min_segment_bases = 0;
+    uint32_t short_segment_cost = 0;
+};
+
+
+/// Alternative to AlignmentChain::split that finds the partition of a sorted chain with the lowest total cost, rather
+/// than splitting greedily at the largest gap. The cost of a subchain is the cost of joining each neighbouring pair in
+/// it, which is their distance plus any contig jump, strand flip or query overlap cost, and the subchain's own split
+/// and short segment costs. Solved exactly in linear time, and the buffers are reused between chains, so each thread
+/// needs its own ChainSegmenter.
+class ChainSegmenter {
+    SegmentationCosts costs;
+
+    // Distance between each neighbouring pair, with the contig jump cost
+    vector<uint32_t> gaps;
+
+    // Prefix sums over the chain, of the cost of joining each neighbouring pair, and of aligned bases
+    vector<int64_t> join_costs;
+    vector<uint64_t> aligned_bases;
+
+    // Lowest cost of each prefix of the chain, its number of subchains, and where its last subchain starts
+    vector<int64_t> best_costs;
+    vector<uint32_t> n_subchains;
+    vector<uint32_t> last_starts;
+
+    // Starts of a last subchain that would still be too short, with increasing cost
+    deque<uint32_t> short_starts;
+
+    /// Cost of joining elements a and b = a + 1, once their gap has been computed
+    int64_t compute_join_cost(const AlignmentChain& chain, size_t a, size_t b) const;
+
+public:
+    explicit ChainSegmenter(const SegmentationCosts& costs);
+
+    /// Fill subchain_bounds with the lowest cost partition of the chain, in query order, and return its cost. Among
+    /// partitions of equal cost, the one with the fewest subchains is chosen. Assumes the chain has been sorted.
+    int64_t split(const AlignmentChain& chain, vector<pair<size_t, size_t> >& subchain_bounds);
+};
+
+
+}
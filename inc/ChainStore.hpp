@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ChainElement.hpp"
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+namespace liger2liger{
+
+
+/// The alignments of every read, as one column per ChainElement field, shared by all reads. Elements are appended in
+/// input order and tagged with their read's id. group_by_read then moves each read's elements into one contiguous
+/// range, in the order they were added, so a chain is just an offset and a length.
+class ChainStore {
+public:
+    vector<uint32_t> contig_ids;
+    vector<uint32_t> ref_starts;
+    vector<uint32_t> ref_stops;
+    vector<uint32_t> query_starts;
+    vector<uint32_t> query_stops;
+    vector<uint32_t> ref_lengths;
+    vector<uint32_t> query_lengths;
+    vector<uint32_t> residue_matches;
+    vector<uint32_t> alignment_lengths;
+    vector<uint32_t> map_qualities;
+    vector<uint8_t> is_reverse;
+
+private:
+    vector<uint32_t> read_ids;
+
+    // Start of each read's range, plus the end of the last one. Only valid while is_grouped.
+    vector<size_t> read_offsets;
+    bool is_grouped;
+
+    // Reused by permute, so that sorting a chain does not allocate
+    vector<uint32_t> scratch;
+
+    template<class T> void for_each_column(const T& f);
+
+public:
+    ChainStore();
+
+    void add(uint32_t read_id, const ChainElement& e);
+
+    /// Append all elements of another store, translating its read and contig ids through the given maps
+    void append(const ChainStore& other, const vector<uint32_t>& read_id_map, const vector<uint32_t>& contig_id_map);
+
+    /// Stable counting sort of the elements by read id. Does nothing if the store is already grouped.
+    void group_by_read(size_t n_reads);
+
+    /// Reorder the range starting at offset, so that its i-th element becomes the one that was at offset + order[i]
+    void permute(size_t offset, const vector<uint32_t>& order);
+
+    /// Range of a read's elements, which requires the store to be grouped
+    size_t get_offset(uint32_t read_id) const;
+    size_t get_length(uint32_t read_id) const;
+
+    ChainElement get_element(size_t index) const;
+    uint32_t get_forward_start(size_t index) const;
+    uint32_t get_forward_stop(size_t index) const;
+    uint32_t distance_to_end_of_contig(size_t index) const;
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+};
+
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <unordered_map>
+#include <string_view>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+
+using std::unordered_map;
+using std::string_view;
+using std::string;
+using std::vector;
+using std::deque;
+
+namespace liger2liger{
+
+
+/// Dictionary of reference contigs, storing each name and length once so that alignments can refer to a contig by a
+/// dense 32 bit id, assigned in order of first appearance.
+class ContigTable {
+    // Deque so that the views used as keys stay valid as names are added
+    deque<string> names;
+    vector<uint32_t> lengths;
+    unordered_map<string_view, uint32_t> ids;
+
+public:
+    ContigTable()=default;
+
+    // The keys of ids point into names, which a copy would not own. Moving the deque keeps its strings in place.
+    ContigTable(const ContigTable& other)=delete;
+    ContigTable& operator=(const ContigTable& other)=delete;
+    ContigTable(ContigTable&& other)=default;
+    ContigTable& operator=(ContigTable&& other)=default;
+
+    /// Fetch the id of a contig, adding it if it is new. Throws if it was already added with a different length.
+    uint32_t get_id(string_view name, uint32_t length);
+
+    /// Fetch the id of a contig that is expected to exist, throwing if it doesn't
+    uint32_t find_id(string_view name) const;
+
+    const string& get_name(uint32_t id) const;
+    uint32_t get_length(uint32_t id) const;
+    size_t size() const;
+    void clear();
+};
+
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+using std::string;
+
+namespace liger2liger{
+
+
+enum class SimdLevel {
+    scalar,
+    sse2,
+    avx2
+};
+
+
+/// Find the first occurrence of either delimiter in [begin, end), returning end if there is none. Dispatches at runtime
+/// to the widest vector implementation supported by the CPU, so one binary works on every node.
+const char* find_delimiter(const char* begin, const char* end, char a, char b);
+
+/// Single delimiter version of the above
+const char* find_delimiter(const char* begin, const char* end, char a);
+
+/// Fixed implementations, exposed for benchmarking. Each must only be called if supported by the CPU.
+const char* find_delimiter_scalar(const char* begin, const char* end, char a, char b);
+const char* find_delimiter_sse2(const char* begin, const char* end, char a, char b);
+const char* find_delimiter_avx2(const char* begin, const char* end, char a, char b);
+
+/// The best implementation this CPU supports, which is the one find_delimiter dispatches to by default
+SimdLevel get_supported_simd_level();
+
+/// Override the dispatch, e.g. to compare implementations. Throws if the CPU does not support the requested level.
+void set_simd_level(SimdLevel level);
+SimdLevel get_simd_level();
+
+string to_string(SimdLevel level);
+
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ChainStore.hpp"
+
+#include <cstdint>
+
+namespace liger2liger{
+
+
+/// Distance between each pair of neighbouring elements in [begin, end) of the store, the same as
+/// AlignmentChain::compute_distance, so that gaps[i] is between elements begin + i and begin + i + 1, and end - begin - 1
+/// gaps are written. Ranges may cover many chains of a grouped store at once, in which case the gap that spans the end
+/// of one chain and the start of the next is meaningless. Dispatches at runtime to AVX2 if the SIMD level set in
+/// DelimiterScanner.hpp allows it, and otherwise to the scalar implementation.
+void compute_gaps(const ChainStore& store, size_t begin, size_t end, uint32_t contig_penalty, uint32_t* gaps);
+
+/// Fixed implementations, exposed for benchmarking. AVX2 must only be called if supported by the CPU.
+void compute_gaps_scalar(const ChainStore& store, size_t begin, size_t end, uint32_t contig_penalty, uint32_t* gaps);
+void compute_gaps_avx2(const ChainStore& store, size_t begin, size_t end, uint32_t contig_penalty, uint32_t* gaps);
+
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "DelimiterScanner.hpp"
+#include "Filesystem.hpp"
+
+#include <string_view>
+
+using ghc::filesystem::path;
+using std::string_view;
+
+namespace liger2liger{
+
+
+/// Read-only memory map of an entire file, unmapped on destruction
+class MappedFile {
+    path file_path;
+    int file_descriptor;
+    const char* data;
+    size_t length;
+
+public:
+    MappedFile(path file_path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile& other)=delete;
+    MappedFile& operator=(const MappedFile& other)=delete;
+
+    const char* begin() const;
+    const char* end() const;
+    size_t size() const;
+    string_view view() const;
+};
+
+
+/// Iterate the newline-delimited lines of a buffer without copying them. A trailing line without '\n' is included.
+template <class F> void for_line_in_buffer(string_view buffer, const F& f){
+    const char* cursor = buffer.data();
+    const char* end = buffer.data() + buffer.size();
+
+    while (cursor < end){
+        auto newline = find_delimiter(cursor, end, '\n');
+
+        f(string_view(cursor, newline - cursor));
+
+        cursor = newline + 1;
+    }
+}
+
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "PafTags.hpp"
+
+#include <string_view>
+#include <cstdint>
+
+using std::string_view;
+
+namespace liger2liger {
+
+
+/// Non-owning view of one PAF line: https://github.com/lh3/miniasm/blob/master/PAF.md
+/// Name fields point into the source buffer and are only valid for as long as that buffer is.
+class PafRecord {
+public:
+    string_view query_name;
+    string_view ref_name;
+    uint32_t query_length;
+    uint32_t query_start;
+    uint32_t query_stop;
+    uint32_t ref_length;
+    uint32_t ref_start;
+    uint32_t ref_stop;
+    uint32_t residue_matches;
+    uint32_t alignment_length;
+    uint32_t map_quality;
+    bool is_reverse;
+    PafTags tags;
+
+    PafRecord()=default;
+};
+
+
+/// Split a line (without its newline) into fields and decode the 12 mandatory columns, allocating nothing. Optional
+/// fields are indexed but not decoded. Returns false if the line does not have enough columns to be PAF, and throws if
+/// a column can't be decoded.
+bool parse_paf_line(string_view line, PafRecord& record);
+
+
+}
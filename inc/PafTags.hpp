@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string_view>
+#include <cstdint>
+#include <array>
+
+using std::string_view;
+using std::array;
+
+namespace liger2liger {
+
+
+/// Index of the SAM-style optional fields ("XX:T:value") of a PAF line that chain filtering and scoring may use. Tags
+/// are found by their two character key in one pass over the fields, wherever they are in the line, and values are
+/// only decoded when requested. Fields point into the line and are only valid for as long as it is.
+class PafTags {
+public:
+    enum Key: uint8_t {
+        type,           // tp:A  P/S/I/i = primary/secondary/inversion
+        n_minimizers,   // cm:i  minimizers on the chain
+        chain_score,    // s1:i  chaining score
+        divergence,     // dv:f  approximate per-base sequence divergence
+        edit_distance,  // NM:i  total mismatches and gaps in the alignment
+        other_alignments,   // SA:Z  the read's other alignments, as written in SAM
+        n_keys
+    };
+
+private:
+    array<string_view, n_keys> values;
+
+public:
+    PafTags()=default;
+
+    /// Tab-separated optional fields, i.e. everything after column 12
+    void index(string_view fields);
+
+    bool has(Key key) const;
+
+    /// Decode the value of a tag, returning false if it is absent. Throws if a present value can't be decoded.
+    bool get_char(Key key, char& value) const;
+    bool get_int(Key key, int64_t& value) const;
+    bool get_float(Key key, float& value) const;
+    bool get_string(Key key, string_view& value) const;
+
+    /// True unless tp:A marks the alignment as secondary. Alignments without the tag are assumed primary.
+    bool is_primary() const;
+};
+
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "AlignmentChain.hpp"
+
+#include <ostream>
+#include <cstdint>
+#include <vector>
+
+using std::ostream;
+using std::vector;
+
+namespace liger2liger{
+
+
+/// Totals for one setting of a ParameterSweep, over every read that has a usable alignment at that setting
+class SweepResult {
+public:
+    size_t n_chimers = 0;
+    size_t n_non_chimers = 0;
+
+    // Subchains of chimeric reads
+    size_t n_subchains = 0;
+
+    vector<uint32_t> chimer_lengths;
+    vector<uint32_t> non_chimer_lengths;
+
+    // Span in the read of each subchain of a chimeric read, from its first aligned base to its last
+    vector<uint32_t> subchain_lengths;
+
+    void merge(SweepResult& other);
+};
+
+
+/// Length such that the lengths at least as long hold at least half of the total, or 0 if there are none. Sorts lengths.
+uint32_t get_n50(vector<uint32_t>& lengths);
+
+
+class ChainGaps;
+
+
+/// Classification of every read at each combination of map quality, gap penalty and max gap, in place of the constants
+/// that ChimerWriter uses. Each read's chain is sorted once, and the distances between its elements computed once per map
+/// quality without any gap penalty, since the penalty is only ever added between contigs, and the max gap only decides
+/// which gaps are breaks.
+class ParameterSweep {
+    vector<uint32_t> min_qualities;
+    vector<uint32_t> gap_penalties;
+    vector<uint32_t> max_gaps;
+
+    // One per setting, in order of min quality, then gap penalty, then max gap
+    vector<SweepResult> results;
+
+    size_t get_index(size_t q, size_t p, size_t g) const;
+    void evaluate(const AlignmentChain& chain, ChainGaps& gaps, vector<SweepResult>& thread_results) const;
+
+public:
+    /// Map qualities can't be below AlignmentChains::min_quality, since alignments at or under it are never loaded
+    ParameterSweep(const vector<uint32_t>& min_qualities, const vector<uint32_t>& gap_penalties, const vector<uint32_t>& max_gaps);
+
+    /// Sort every chain, then classify the reads at every setting on n_threads threads, each taking a range of reads
+    void evaluate(AlignmentChains& chains, size_t n_threads);
+
+    /// One tab separated line per setting, with a header
+    void write_table(ostream& file);
+
+    size_t size() const;
+};
+
+
+}
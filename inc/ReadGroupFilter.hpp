@@ -0,0 +1,62 @@
+#pragma once
+
+#include <unordered_set>
+#include <string_view>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::unordered_set;
+using std::string_view;
+using std::string;
+using std::vector;
+
+namespace liger2liger{
+
+
+/// Check that the records of each read are adjacent in a streamed input. The 64 bit hash of each closed group's name is
+/// kept in an open addressing table, which takes 8 bytes per read at most 3/4 full, so 11 to 21 bytes per read as it
+/// doubles. A name that starts a new group and has a hash in the table has almost certainly been seen before: among n
+/// reads, some pair of names collides with chance about n^2/2^65, which is under 1 in 3000 for a whole run of 100M reads.
+/// Such a name is only held as a suspect, until a pass over the input with verify confirms whether its group is repeated,
+/// for inputs that can be read again.
+class ReadGroupFilter {
+    // Hashes of the names of closed groups, where 0 marks an empty slot
+    vector<uint64_t> slots;
+    size_t n_closed;
+
+    // Hashes of the names that were found in the table, and are not yet verified
+    unordered_set<uint64_t> suspects;
+
+    // State of a verifying pass, in which only suspects are tracked exactly
+    string verify_name;
+    unordered_set<string> verify_closed;
+
+    /// Never 0, which marks an empty slot
+    static uint64_t hash(string_view name);
+    bool contains(uint64_t h) const;
+    void insert(uint64_t h);
+
+public:
+    static const size_t initial_n_slots = 1 << 16;
+
+    ReadGroupFilter();
+
+    /// Record that the group of a read has ended
+    void close(string_view name);
+
+    /// Whether a read that starts a new group may have had a group that closed already, in which case it is kept as a
+    /// suspect. False is always correct.
+    bool may_be_closed(string_view name);
+
+    /// Call with the read name of every record of the input, in order, on a pass that starts after the current
+    /// suspects were found. Returns false once a suspect starts a group after its earlier group closed, i.e. its records
+    /// are confirmed not to be adjacent. If the pass ends without that, call end_verifying.
+    bool verify(string_view name);
+
+    /// Clear the suspects of a pass that found each of them in only one group, so they were hash collisions
+    void end_verifying();
+};
+
+
+}
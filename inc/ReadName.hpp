@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string_view>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+using std::string_view;
+using std::ostream;
+using std::string;
+
+namespace liger2liger{
+
+
+/// 16 byte read name key. Canonical lowercase UUIDs, as written by ONT basecallers, are packed into the 128 bits of
+/// their hex digits. Any other name is stored in a ReadNameArena, and the key holds its offset and length.
+///
+/// Arena keys are told apart by the UUID version digit (the 13th hex digit) being 0, which no RFC 4122 UUID has. The
+/// rare UUID that does have version 0 is just stored in the arena.
+class ReadName {
+public:
+    uint64_t high;
+    uint64_t low;
+
+    bool is_uuid() const;
+    uint64_t get_arena_offset() const;
+    uint32_t get_arena_length() const;
+
+    bool operator==(const ReadName& other) const;
+    bool operator!=(const ReadName& other) const;
+};
+
+
+/// Backing store for read names that are not UUIDs, and the only way to encode or decode a ReadName
+class ReadNameArena {
+    string data;
+    size_t n_uuid;
+    size_t n_other;
+
+public:
+    ReadNameArena();
+
+    /// Build a key for a name, appending the name to the arena if it is not a UUID
+    ReadName encode(string_view name);
+
+    /// Recover the exact original name. UUIDs are rebuilt in the buffer, which must hold 36 chars.
+    string_view decode(const ReadName& key, char* buffer) const;
+    string to_string(const ReadName& key) const;
+
+    /// Same order as comparing the decoded names
+    bool less(const ReadName& a, const ReadName& b) const;
+
+    void clear();
+
+    /// Summarize how many names were encoded each way, and how much memory that takes compared to std::string keys
+    void write_stats(ostream& o) const;
+};
+
+
+/// Parse a canonical lowercase UUID, returning false if the name is not one
+bool pack_uuid(string_view name, ReadName& result);
+
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ReadName.hpp"
+
+#include <string_view>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using std::string_view;
+using std::ostream;
+using std::string;
+using std::vector;
+
+namespace liger2liger{
+
+
+/// Finalizer of splitmix64, so that every bit of the input affects the low bits of the result
+uint64_t mix_bits(uint64_t x);
+
+
+/// Dictionary of read names, assigning each a dense 32 bit id in order of first appearance, so that per-read data can
+/// live in a plain vector. Names are stored as ReadName keys, and looked up through an open addressing hash index with
+/// linear probing, which keeps a lookup to one or two cache lines instead of a tree walk with string compares.
+class ReadNameTable {
+    // One slot of the hash index. The tag is the upper half of the name's hash, so most mismatching slots are skipped
+    // without touching the key.
+    class Slot {
+    public:
+        uint32_t tag;
+        uint32_t id;
+    };
+
+    static const uint32_t empty_id = UINT32_MAX;
+
+    ReadNameArena arena;
+    vector<ReadName> keys;
+    vector<Slot> slots;
+
+    uint64_t hash(const ReadName& key) const;
+    static uint64_t hash(const ReadName& key, string_view name);
+    bool find_id(string_view name, uint64_t& name_hash, ReadName& name_key, size_t& slot_index, uint32_t& id) const;
+    void resize(size_t n_slots);
+
+public:
+    ReadNameTable();
+
+    /// Fetch the id of a read, adding it if it is new. New ids are always equal to the previous size().
+    uint32_t get_id(string_view name);
+
+    /// Fetch the id of a read without adding it, returning false if it is not present
+    bool find_id(string_view name, uint32_t& id) const;
+
+    /// Recover the exact original name. UUIDs are rebuilt in the buffer, which must hold 36 chars.
+    string_view get_name(uint32_t id, char* buffer) const;
+    string get_name(uint32_t id) const;
+
+    /// All ids, ordered by their names
+    vector<uint32_t> get_sorted_ids() const;
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    /// Summarize the memory taken by the names and the index
+    void write_stats(ostream& o) const;
+};
+
+
+}
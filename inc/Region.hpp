@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Filesystem.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using ghc::filesystem::path;
+using std::string;
+using std::vector;
+
+namespace liger2liger{
+
+
+/// A 0-based, half open interval of a reference contig
+class Region {
+public:
+    string contig;
+    int64_t start;
+    int64_t stop;
+
+    Region(const string& contig, int64_t start, int64_t stop);
+};
+
+
+/// Parse a samtools-style region, "chr1" or "chr1:100-200", with 1-based inclusive coordinates. A contig without
+/// coordinates covers the whole contig, and its name may contain ':'.
+Region parse_region(const string& region);
+
+/// Load the first 3 columns of a BED file, skipping blank, comment, "track" and "browser" lines
+vector<Region> load_bed(path bed_path);
+
+/// A path to a .bed file, or else a comma separated list of samtools-style regions
+vector<Region> parse_regions(const string& regions);
+
+
+}
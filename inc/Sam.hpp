@@ -1,15 +1,21 @@
 #pragma once
 
+#include "BgzfLineReader.hpp"
 #include "Filesystem.hpp"
+#include "PafTags.hpp"
 
 using ghc::filesystem::path;
 
+#include <unordered_map>
+#include <string_view>
 #include <functional>
 #include <iostream>
 #include <bitset>
 #include <string>
 #include <vector>
 
+using std::unordered_map;
+using std::string_view;
 using std::function;
 using std::ostream;
 using std::bitset;
@@ -43,6 +49,54 @@ public:
 };
 
 
+/// Non-owning view of the fields of one SAM line that chains are built from. Fields point into the line and are only
+/// valid for as long as it is.
+class SamRecord {
+public:
+    string_view query_name;
+    string_view ref_name;
+    string_view cigar;
+
+    // 0-based, so -1 for unmapped records
+    int64_t ref_start;
+    uint32_t map_quality;
+    uint16_t flag;
+
+    // Optional fields, of which SA:Z and NM:i are the ones SAM adds to PAF's
+    PafTags tags;
+
+    SamRecord()=default;
+    bool is_reverse() const;
+    bool is_primary() const;
+};
+
+
+/// Split a SAM line (without its newline) and decode the mandatory columns that chains need, allocating nothing.
+/// Returns false if the line has fewer than 11 columns, and throws if a column can't be decoded.
+bool parse_sam_line(string_view line, SamRecord& record);
+
+
+/// Reader of SAM text from a plain, gzipped or BGZF file, or stdin if the path is "-". The header is consumed on
+/// construction, keeping only the length of each @SQ contig.
+class SamReader {
+    BgzfLineReader file;
+    unordered_map<string, uint32_t> ref_lengths;
+
+    // The first record, which had to be read to find the end of the header
+    string_view pending_line;
+    bool has_pending_line;
+
+public:
+    SamReader(path sam_path, size_t n_threads);
+
+    /// Parse the next record. The record is only valid until the next call. Returns false at EOF.
+    bool next_record(SamRecord& record);
+
+    /// Length of a contig from its @SQ line, throwing if it has none. Unmapped records ("*") have length 0.
+    uint32_t get_ref_length(string_view ref_name) const;
+};
+
+
 void for_element_in_sam_file(path sam_path, const function<void(SamElement& e)>& f);
 
 
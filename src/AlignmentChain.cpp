@@ -1,16 +1,27 @@
 #include "AlignmentChain.hpp"
+#include "BgzfLineReader.hpp"
+#include "MappedFile.hpp"
 #include "Bam.hpp"
+#include "Sam.hpp"
+#include "GapKernel.hpp"
+#include "ReadGroupFilter.hpp"
+#include "DelimiterScanner.hpp"
 
 #include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
+#include <exception>
+#include <thread>
+#include <cstring>
+#include <cctype>
 #include <cmath>
 
 
 using std::runtime_error;
-using std::ifstream;
+using std::exception_ptr;
+using std::thread;
 using std::ofstream;
 using std::ostream;
 using std::to_string;
@@ -23,193 +34,584 @@ using std::max;
 
 namespace liger2liger {
 
-ChainElement::ChainElement(
-        const string& ref_name,
-        uint32_t ref_start,
-        uint32_t ref_stop,
-        uint32_t query_start,
-        uint32_t query_stop,
-        uint32_t ref_length,
-        uint32_t query_length,
-        uint32_t residue_matches,
-        uint32_t alignment_length,
-        uint32_t mapping_quality,
-        bool is_reverse) :
-        ref_name(ref_name),
-        ref_start(ref_start),
-        ref_stop(ref_stop),
-        query_start(query_start),
-        query_stop(query_stop),
-        ref_length(ref_length),
-        query_length(query_length),
-        residue_matches(residue_matches),
-        alignment_length(alignment_length),
-        map_quality(mapping_quality),
-        is_reverse(is_reverse) {}
-
-
-uint32_t ChainElement::get_forward_start() const {
-    if (is_reverse) {
-        return ref_stop;
-    } else {
-        return ref_start;
-    }
+/// Load a PAF through a buffered reader, which also reads it if it is compressed
+void AlignmentChains::load_from_paf(path paf_path) {
+    PafSource source(paf_path);
+    load(source);
 }
 
 
-uint32_t ChainElement::get_forward_stop() const {
-    if (is_reverse) {
-        return ref_start;
-    } else {
-        return ref_stop;
-    }
+void AlignmentChains::add(string_view read_name, const ChainElement& e) {
+    elements.add(read_names.get_id(read_name), e);
 }
 
 
-uint32_t ChainElement::distance_to_end_of_contig() const {
-    uint32_t distance;
+/// Elements are grouped by read the first time a chain is read after loading, so this is only valid until the next add
+AlignmentChain AlignmentChains::get_chain(uint32_t read_id) {
+    elements.group_by_read(read_names.size());
 
-    if (is_reverse) {
-        distance = ref_start;
-    } else {
-        distance = ref_length - ref_stop;
+    return {elements, elements.get_offset(read_id), elements.get_length(read_id)};
+}
+
+
+/// Iterate chains in order of read name, or in order of each read's first alignment in the input, with each name
+/// decoded back to its original text
+void AlignmentChains::for_each_chain(
+        const function<void(string_view read_name, AlignmentChain& chain)>& f,
+        ReadOrder order) {
+
+    char buffer[36];
+
+    auto visit = [&](uint32_t id){
+        auto chain = get_chain(id);
+        f(read_names.get_name(id, buffer), chain);
+    };
+
+    if (order == ReadOrder::first_seen) {
+        for (uint32_t id=0; id<read_names.size(); id++) {
+            visit(id);
+        }
     }
+    else {
+        for (auto id: read_names.get_sorted_ids()) {
+            visit(id);
+        }
+    }
+}
 
-    return distance;
+
+/// Same as load_from_paf, but the file is memory mapped and parsed in place, so lines are never copied
+void AlignmentChains::load_from_paf_mmap(path paf_path) {
+    MappedFile paf_file(paf_path);
+
+    load_from_paf_buffer(paf_file.view());
 }
 
 
-ostream& operator<<(ostream& o, const ChainElement& e) {
-    o << '(' << e.query_start << ',' << e.query_stop << ")" << (e.is_reverse ? "-" : "+") << " " << e.ref_name << " "
-      << e.ref_start << " " << e.ref_stop << " " << e.ref_length << " " << e.map_quality;
-    return o;
+/// Load a gzip or BGZF compressed PAF, or stdin if the path is "-", using n_threads to decompress BGZF
+void AlignmentChains::load_from_compressed_paf(path paf_path, size_t n_threads) {
+    PafSource source(paf_path, n_threads);
+    load(source);
 }
 
 
-void AlignmentChains::load_from_paf(path paf_path) {
-    ifstream paf_file(paf_path);
-
-    if (not paf_file.good()) {
-        throw runtime_error("ERROR: could not open input file: " + paf_path.string());
-    }
-
-    string line;
-
-    while (getline(paf_file, line)) {
-        add_alignment(line);
-    }
-}
-
-
-void AlignmentChains::load_from_bam(path bam_path) {
-    Bam reader(bam_path);
-
-    string line;
-
-    reader.for_alignment_in_bam(true, [&](const SamElement& alignment){
-        uint32_t start_clip = 0;
-        uint32_t end_clip = 0;
-        uint32_t query_start;
-        uint32_t query_stop;
-        uint32_t query_length;
-        uint32_t ref_start;
-        uint32_t ref_stop;
-        uint32_t ref_length;
-        uint32_t alignment_length;
-        uint32_t n_matches = 0;
-        uint32_t n_inserts = 0;
-        uint32_t n_deletes = 0;
-        uint32_t n_n = 0;
-
-        size_t i = 0;
-        /// 		while ((m = re.exec(t[5])) != null) {
-        ///			var l = parseInt(m[1]), op = m[2];
-        ///			if (op == 'M') M += l, have_M = true;
-        ///			else if (op == 'I') ++I[0], I[1] += l;
-        ///			else if (op == 'D') ++D[0], D[1] += l;
-        ///			else if (op == 'N') N += l;
-        ///			else if (op == 'S') clip[n_cigar == 0? 0 : 1] = l, soft_clip += l;
-        ///			else if (op == 'H') clip[n_cigar == 0? 0 : 1] = l;
-        ///			else if (op == '=') M += l, have_ext = true, op = 'M';
-        ///			else if (op == 'X') M += l, mm += l, have_ext = true, op = 'M';
-        ///			++n_cigar;
-        ///			if (MD != null && op != 'H') {
-        ///				if (cigar.length > 0 && cigar[cigar.length-1][1] == op)
-        ///					cigar[cigar.length-1][0] += l;
-        ///				else cigar.push([l, op]);
-        ///			}
-        ///		}
-        ///		var ql = M + I[1] + soft_clip;
-        ///		var tl = M + D[1] + N;
-
-        alignment.for_each_cigar([&](char type, uint32_t length){
-            if (type == 'M' or type == 'X' or type == '='){
-                n_matches += length;
+/// Parse a memory mapped PAF in n_threads byte ranges, each into its own AlignmentChains, and then merge them
+void AlignmentChains::load_from_paf_parallel(path paf_path, size_t n_threads) {
+    MappedFile paf_file(paf_path);
+
+    auto buffer = paf_file.view();
+
+    if (n_threads == 0) {
+        throw runtime_error("ERROR: cannot load PAF with 0 threads");
+    }
+
+    // Cut the file into roughly equal ranges, moving each cut forward to the start of the next line
+    vector<size_t> cuts = {0};
+
+    for (size_t i=1; i<n_threads; i++) {
+        size_t cut = max(cuts.back(), (buffer.size()/n_threads)*i);
+
+        if (cut > 0 and cut < buffer.size() and buffer[cut - 1] != '\n') {
+            cut = buffer.find('\n', cut);
+            cut = (cut == string_view::npos) ? buffer.size() : cut + 1;
+        }
+
+        cuts.emplace_back(cut);
+    }
+
+    cuts.emplace_back(buffer.size());
+
+    vector<AlignmentChains> thread_chains(n_threads);
+    vector<exception_ptr> exceptions(n_threads);
+    vector<thread> threads;
+
+    for (size_t i=0; i<n_threads; i++) {
+        threads.emplace_back([&, i](){
+            try {
+                thread_chains[i].load_from_paf_buffer(buffer.substr(cuts[i], cuts[i+1] - cuts[i]));
+            }
+            catch (...) {
+                exceptions[i] = std::current_exception();
             }
-            else if (type == 'I'){
-                n_inserts += length;
+        });
+    }
+
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    for (auto& e: exceptions) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+
+    // Merge pairs of neighbouring ranges in parallel until one remains. The left side of each pair always precedes the
+    // right side in the file, so the elements of a read that straddles a cut stay in file order.
+    for (size_t stride=1; stride < n_threads; stride *= 2) {
+        threads.clear();
+
+        for (size_t i=0; i + stride < n_threads; i += 2*stride) {
+            threads.emplace_back([&, i, stride](){
+                thread_chains[i].merge(thread_chains[i + stride]);
+            });
+        }
+
+        for (auto& t: threads) {
+            t.join();
+        }
+    }
+
+    merge(thread_chains[0]);
+}
+
+
+/// Stream a PAF in which all alignments of a read are adjacent, calling f on each read's chain as soon as the next
+/// read begins. Only one read is held at a time, and a read that reappears after its group has closed is an error. Closed
+/// reads are tracked by the hashes of their names, so a repeat is confirmed by reading the file again as soon as it is
+/// found, which a hash collision alone only makes necessary about once in 3000 runs of 100M reads. Stdin can't be read
+/// again, so there a repeated hash is an error straight away.
+void AlignmentChains::for_read_in_paf(
+        path paf_path,
+        size_t n_threads,
+        const function<void(string_view name, AlignmentChain& chain)>& f) {
+
+    if (not read_names.empty()) {
+        throw runtime_error("ERROR: cannot stream PAF into non-empty AlignmentChains");
+    }
+
+    auto for_line = [&](const function<void(string_view line)>& g){
+        if (is_stream_path(paf_path)) {
+            BgzfLineReader paf_file(paf_path, n_threads);
+            string_view line;
+
+            while (paf_file.next_line(line)) {
+                g(line);
             }
-            else if (type == 'D'){
-                n_deletes += length;
+        }
+        else {
+            MappedFile paf_file(paf_path);
+            for_line_in_buffer(paf_file.view(), g);
+        }
+    };
+
+    auto not_grouped_error = [&](const string& name){
+        return runtime_error("ERROR: alignments for read " + name + " are not adjacent in PAF. "
+                             "Streaming requires input grouped by read name, rerun without streaming.");
+    };
+
+    ReadGroupFilter closed_reads;
+    string current_read;
+    PafRecord record;
+
+    auto verify_suspects = [&](){
+        for_line([&](string_view line){
+            if (line.empty()){
+                return;
             }
-            else if (type == 'N'){
-                n_n += length;
+
+            string_view name = line.substr(0, find_delimiter(line.data(), line.data() + line.size(), '\t') - line.data());
+
+            if (not closed_reads.verify(name)) {
+                throw not_grouped_error(string(name));
             }
-            else if (type == 'S' or type == 'H'){
-                if (i == 0){
-                    start_clip = length;
+        });
+
+        closed_reads.end_verifying();
+    };
+
+    auto close_group = [&](){
+        // Reads with no alignments passing the filters are skipped, like when loading the whole file
+        if (not read_names.empty()) {
+            auto chain = get_chain(0);
+            f(current_read, chain);
+            elements.clear();
+            read_names.clear();
+        }
+
+        closed_reads.close(current_read);
+    };
+
+    auto add_line = [&](string_view line){
+        if (line.empty()){
+            return;
+        }
+
+        if (not parse_paf_line(line, record)) {
+            throw runtime_error("ERROR: file provided does not contain sufficient tab delimiters to be PAF");
+        }
+
+        if (record.query_name != current_read) {
+            if (not current_read.empty()) {
+                close_group();
+            }
+
+            current_read = record.query_name;
+
+            if (closed_reads.may_be_closed(current_read)) {
+                if (paf_path == "-") {
+                    throw not_grouped_error(current_read + " (or a read whose name hash collides with it)");
                 }
-                else{
-                    end_clip = length;
+
+                verify_suspects();
+            }
+        }
+
+        add_alignment(record);
+    };
+
+    for_line(add_line);
+
+    if (not current_read.empty()) {
+        close_group();
+    }
+}
+
+
+/// Move all chains out of another AlignmentChains, appending elements to any read that is already present here. Reads
+/// that are new here get ids after the existing ones, in the other's first-seen order.
+void AlignmentChains::merge(AlignmentChains& other) {
+    if (read_names.empty() and contigs.size() == 0) {
+        std::swap(elements, other.elements);
+        std::swap(read_names, other.read_names);
+        std::swap(contigs, other.contigs);
+        return;
+    }
+
+    // Translate the other table's contig ids into this one's, adding any contigs that are new here
+    vector<uint32_t> contig_ids(other.contigs.size());
+
+    for (uint32_t id=0; id<other.contigs.size(); id++) {
+        contig_ids[id] = contigs.get_id(other.contigs.get_name(id), other.contigs.get_length(id));
+    }
+
+    vector<uint32_t> read_ids(other.read_names.size());
+    char buffer[36];
+
+    for (uint32_t id=0; id<other.read_names.size(); id++) {
+        read_ids[id] = read_names.get_id(other.read_names.get_name(id, buffer));
+    }
+
+    // Appended after this store's elements, which come first in the file, so grouping keeps each read in file order
+    elements.append(other.elements, read_ids, contig_ids);
+
+    other.elements.clear();
+    other.read_names.clear();
+    other.contigs.clear();
+}
+
+
+void AlignmentChains::load_from_paf_buffer(string_view buffer) {
+    PafBufferSource source(buffer);
+    load(source);
+}
+
+
+/// Load a BAM, using n_threads to decompress it. Spans are computed from the CIGAR of the reused record, and contigs are
+/// looked up by target id, so no per-record strings or CIGAR copies are made.
+void AlignmentChains::load_from_bam(path bam_path, size_t n_threads) {
+    BamSource source(bam_path, n_threads);
+    load(source);
+}
+
+
+/// Same as above, but if any regions are given only the alignments overlapping them are loaded, through the index. With
+/// include_linked, the supplementary alignments and mates of those reads are loaded too, so their chains are complete.
+/// CRAM is read the same way, with reference_path used to decode it if its header doesn't locate the reference.
+void AlignmentChains::load_from_bam(
+        path bam_path,
+        size_t n_threads,
+        const vector<Region>& regions,
+        bool include_linked,
+        path reference_path) {
+
+    for_element_in_bam(bam_path, n_threads, regions, include_linked, reference_path, [&](string_view name, const ChainElement& e){
+        add(name, e);
+    });
+}
+
+
+/// Convert each BAM or CRAM record to a chain element without adding it, so the caller decides where it is kept. Contig
+/// ids still refer to this object's contigs. Elements that are not usable are skipped, as they are by load.
+void AlignmentChains::for_element_in_bam(
+        path bam_path,
+        size_t n_threads,
+        const vector<Region>& regions,
+        bool include_linked,
+        path reference_path,
+        const function<void(string_view read_name, const ChainElement& e)>& f) {
+
+    if (regions.empty()) {
+        BamSource source(bam_path, n_threads, reference_path);
+        AlignmentBatch batch;
+
+        while (source.next_batch(batch, contigs)) {
+            for (size_t i=0; i<batch.size(); i++) {
+                if (is_usable(batch.elements[i])) {
+                    f(batch.get_name(i), batch.elements[i]);
                 }
             }
+        }
+
+        return;
+    }
+
+    Bam reader(bam_path, n_threads, reference_path);
+    TargetContigIds target_contig_ids;
+
+    reader.for_record_in_regions(regions, include_linked, [&](const bam1_t* record, const bam_hdr_t* header){
+        auto e = target_contig_ids.get_element(record, header, contigs);
+
+        if (is_usable(e)) {
+            f(bam_get_qname(record), e);
+        }
+    });
+}
+
+
+/// Stream a BAM in which all records of a read are adjacent, such as one sorted by name, calling f on each read's chain
+/// along with its records, so that the records can be modified, e.g. to be tagged and written out again. Each usable
+/// record becomes an element, so before the chain is sorted element i is records[record_indexes[i]]. A read with no
+/// usable records is passed with an empty chain.
+void AlignmentChains::for_read_in_grouped_bam(
+        Bam& reader,
+        const function<void(
+                string_view name,
+                AlignmentChain& chain,
+                const BamRecordBatch& records,
+                const vector<uint32_t>& record_indexes)>& f) {
+
+    if (not read_names.empty()) {
+        throw runtime_error("ERROR: cannot stream BAM into non-empty AlignmentChains");
+    }
+
+    TargetContigIds target_contig_ids;
+    vector<uint32_t> record_indexes;
+
+    reader.for_read_in_bam([&](const BamRecordBatch& records, const bam_hdr_t* header){
+        string_view name = bam_get_qname(records.records[0]);
+
+        record_indexes.clear();
+
+        for (size_t i=0; i<records.size; i++) {
+            auto e = target_contig_ids.get_element(records.records[i], header, contigs);
+
+            if (is_usable(e)) {
+                add(name, e);
+                record_indexes.emplace_back(i);
+            }
+        }
+
+        AlignmentChain chain(elements, 0, 0);
+
+        if (not read_names.empty()) {
+            chain = get_chain(0);
+        }
+
+        f(name, chain, records, record_indexes);
+
+        elements.clear();
+        read_names.clear();
+    });
+}
+
+
+/// Build each read's chain from its primary record alone, which lists every supplementary alignment of the read in its
+/// SA tag, and pass it to f as soon as that record is read. Secondary and supplementary records are skipped without
+/// decoding them, and the input doesn't need to be grouped by read, so nothing is held beyond the current chain.
+/// Secondary alignments are not in SA tags, so unlike load_from_bam they are left out, and each mate of a pair is its own
+/// chain. Reads with no usable alignments are skipped.
+void AlignmentChains::for_read_in_bam_primary(
+        path bam_path,
+        size_t n_threads,
+        path reference_path,
+        const function<void(string_view name, AlignmentChain& chain)>& f) {
+
+    if (not read_names.empty()) {
+        throw runtime_error("ERROR: cannot stream BAM into non-empty AlignmentChains");
+    }
+
+    Bam reader(bam_path, n_threads, reference_path);
+    TargetContigIds target_contig_ids;
+
+    reader.for_primary_record_in_bam([&](const bam1_t* record, const bam_hdr_t* header){
+        string_view name = bam_get_qname(record);
 
-            i++;
+        auto e = target_contig_ids.get_element(record, header, contigs);
+
+        if (is_usable(e)) {
+            add(name, e);
+        }
+
+        Bam::for_sa_entry(record, [&](const SaEntry& entry){
+            auto sa_tid = bam_name2id(const_cast<bam_hdr_t*>(header), entry.ref_name.c_str());
+
+            if (sa_tid < 0 or entry.ref_start < 0) {
+                throw runtime_error("ERROR: SA tag of read " + string(name) + " refers to unknown contig: " + entry.ref_name);
+            }
+
+            auto sa_e = get_sa_element(
+                    name,
+                    entry,
+                    target_contig_ids.get_id(sa_tid, header, contigs),
+                    target_contig_ids.get_length(sa_tid, header));
+
+            if (is_usable(sa_e)) {
+                add(name, sa_e);
+            }
         });
 
-        query_length = n_matches + n_inserts + start_clip + end_clip;
-        alignment_length = n_matches + n_inserts + n_deletes;
-        ref_start = alignment.ref_start;
-        ref_stop = ref_start + n_matches + n_deletes;
-        ref_length = alignment.ref_length;
+        if (read_names.empty()) {
+            return;
+        }
+
+        auto chain = get_chain(0);
+        f(name, chain);
+
+        elements.clear();
+        read_names.clear();
+    });
+}
+
+
+/// Load SAM text from a file or stdin ("-"), plain or compressed, the same way as load_from_bam, using n_threads to
+/// decompress BGZF. Spans are computed from the CIGAR text, so nothing is converted to BAM first.
+void AlignmentChains::load_from_sam(path sam_path, size_t n_threads) {
+    SamSource source(sam_path, n_threads);
+    load(source);
+}
+
+
+/// Same as for_read_in_bam_primary, for SAM text: each read's chain is its primary record and the entries of its SA tag,
+/// and is passed to f as soon as the primary record is parsed
+void AlignmentChains::for_read_in_sam_primary(
+        path sam_path,
+        size_t n_threads,
+        const function<void(string_view name, AlignmentChain& chain)>& f) {
 
-        if (alignment.is_reverse()){
-            query_start = end_clip;
-            query_stop = query_length - start_clip;
+    if (not read_names.empty()) {
+        throw runtime_error("ERROR: cannot stream SAM into non-empty AlignmentChains");
+    }
+
+    SamReader reader(sam_path, n_threads);
+    SamRecord record;
+
+    while (reader.next_record(record)) {
+        if (not record.is_primary()) {
+            continue;
         }
-        else{
-            query_start = start_clip;
-            query_stop = query_length - end_clip;
+
+        string_view name = record.query_name;
+        auto e = SamSource::get_element(record, reader, contigs);
+
+        if (is_usable(e)) {
+            add(name, e);
         }
 
-        ChainElement e(
-                alignment.ref_name,
-                ref_start,
-                ref_stop,
-                query_start,
-                query_stop,
-                ref_length,
-                query_length,
-                n_matches,
-                alignment_length,
-                uint32_t(alignment.mapq),
-                alignment.is_reverse());
+        string_view sa_tag;
+
+        if (record.tags.get_string(PafTags::other_alignments, sa_tag)) {
+            for_sa_entry(sa_tag, [&](const SaEntry& entry){
+                auto sa_ref_length = reader.get_ref_length(entry.ref_name);
+                auto sa_e = get_sa_element(name, entry, contigs.get_id(entry.ref_name, sa_ref_length), sa_ref_length);
+
+                if (is_usable(sa_e)) {
+                    add(name, sa_e);
+                }
+            });
+        }
 
-        chains[alignment.query_name].add(e);
+        if (read_names.empty()) {
+            continue;
+        }
+
+        auto chain = get_chain(0);
+        f(name, chain);
+
+        elements.clear();
+        read_names.clear();
+    }
+}
+
+
+/// Group the alignments of a BAM or CRAM by read without holding all of them in memory, for inputs that are sorted by
+/// coordinate rather than by read. Elements are spilled to hash partitions in a new directory named temp_directory with
+/// a unique suffix, then each partition is loaded on its own and its reads passed to f, by name within a partition.
+/// Memory stays near max_memory bytes whatever the input size, unless a single read has more alignments than fit in it.
+void AlignmentChains::for_read_in_bam(
+        path bam_path,
+        size_t n_threads,
+        const vector<Region>& regions,
+        bool include_linked,
+        path reference_path,
+        size_t max_memory,
+        path temp_directory,
+        const function<void(string_view name, AlignmentChain& chain)>& f) {
+
+    if (not read_names.empty()) {
+        throw runtime_error("ERROR: cannot spill BAM into non-empty AlignmentChains");
+    }
 
+    // Half of the budget is for the spill buffers, and the rest for the Bam reader and the contig table
+    ChainPartitions partitions(temp_directory, n_spill_partitions, max_memory/2);
+
+    for_element_in_bam(bam_path, n_threads, regions, include_linked, reference_path, [&](string_view name, const ChainElement& e){
+        partitions.add(name, e);
     });
+
+    partitions.flush();
+
+    for_read_in_partitions(partitions, max_memory, f);
+}
+
+
+void AlignmentChains::for_read_in_partitions(
+        ChainPartitions& partitions,
+        size_t max_memory,
+        const function<void(string_view name, AlignmentChain& chain)>& f) {
+
+    for (size_t i=0; i<partitions.size(); i++) {
+        // A partition that would not fit once loaded is spilled again with a different hash, unless it only holds one
+        // read, in which case no split can make it smaller
+        if (partitions.get_partition_size(i)*bytes_per_spilled_byte > max_memory and partitions.is_splittable(i)) {
+            auto directory = partitions.get_directory() / ("partition_" + std::to_string(i));
+            ChainPartitions sub_partitions(directory, n_spill_partitions, max_memory/2, partitions.get_seed() + 1);
+
+            partitions.for_element_in_partition(i, [&](string_view name, const ChainElement& e){
+                sub_partitions.add(name, e);
+            });
+
+            partitions.remove(i);
+            sub_partitions.flush();
+
+            for_read_in_partitions(sub_partitions, max_memory, f);
+            continue;
+        }
+
+        partitions.for_element_in_partition(i, [&](string_view name, const ChainElement& e){
+            add(name, e);
+        });
+
+        partitions.remove(i);
+
+        for_each_chain(f);
+
+        elements.clear();
+        read_names.clear();
+    }
 }
 
+
 void print_subchains(
         const AlignmentChain& chain,
-        const set<pair<size_t, size_t> >& subchain_bounds,
-        const string& read_name) {
+        const vector<pair<size_t, size_t> >& subchain_bounds,
+        string_view read_name) {
 
     cout << "Subchains created for read " << read_name << '\n';
 
     for (auto& item: subchain_bounds) {
         for (size_t i = item.first; i < item.second; i++) {
-            cout << '\t' << chain.chain[i] << '\n';
+            cout << '\t' << chain[i] << '\n';
         }
 
         cout << '\n';
@@ -217,132 +619,198 @@ void print_subchains(
 }
 
 
-void AlignmentChain::add(ChainElement& e) {
-    chain.emplace_back(e);
+AlignmentChain::AlignmentChain(ChainStore& store, size_t offset, size_t length):
+    store(&store),
+    offset(offset),
+    length(length)
+{}
+
+
+ChainElement AlignmentChain::operator[](size_t i) const {
+    return store->get_element(offset + i);
 }
 
 
-bool parse_reversal_token(string& token) {
-    bool is_reverse;
+/// Parse one or more lines of a PAF file: https://github.com/lh3/miniasm/blob/master/PAF.md
+void AlignmentChains::add_alignment(string_view line) {
+    load_from_paf_buffer(line);
+}
 
-    if (token == "-") {
-        is_reverse = true;
-    } else if (token == "+") {
-        is_reverse = false;
-    } else {
-        throw runtime_error("ERROR: uninterpretable directional symbol is not '-' or '+': " + token);
-    }
-
-    return is_reverse;
-}
-
-/// Parse a PAF file: https://github.com/lh3/miniasm/blob/master/PAF.md
-void AlignmentChains::add_alignment(string line) {
-    string token;
-    string region_name;
-    string query_name;
-    uint32_t ref_start = 0;
-    uint32_t ref_stop = 0;
-    uint32_t ref_length = 0;
-    uint32_t query_start = 0;
-    uint32_t query_stop = 0;
-    uint32_t query_length = 0;
-    uint32_t map_quality = 0;
-    uint32_t residue_matches = 0;
-    uint32_t alignment_length = 0;
-    uint32_t n_minimizers = 0;
-    bool is_reverse = false;
-
-    uint64_t n_delimiters = 0;
-
-    for (char c: line) {
-        if (c == '\t') {
-            if (n_delimiters == 0) {
-                query_name = token;
-            } else if (n_delimiters == 1) {
-                query_length = stoi(token);
-            } else if (n_delimiters == 2) {
-                query_start = stoi(token);
-            } else if (n_delimiters == 3) {
-                query_stop = stoi(token);
-            } else if (n_delimiters == 4) {
-                is_reverse = parse_reversal_token(token);
-            } else if (n_delimiters == 5) {
-                region_name = token;
-            } else if (n_delimiters == 6) {
-                ref_length = stoi(token);
-            } else if (n_delimiters == 7) {
-                ref_start = stoi(token);
-            } else if (n_delimiters == 8) {
-                ref_stop = stoi(token);
-            } else if (n_delimiters == 9) {
-                residue_matches = stoi(token);
-            } else if (n_delimiters == 10) {
-                alignment_length = stoi(token);
-            } else if (n_delimiters == 11) {
-                map_quality = stoi(token);
-            } else if (n_delimiters == 13) {
-                n_minimizers = stoi(token.substr(5, token.size() - 5));
-
-                if (map_quality > min_quality and n_minimizers > min_chain_minimizers) {
-                    ChainElement e(
-                            region_name,
-                            ref_start,
-                            ref_stop,
-                            query_start,
-                            query_stop,
-                            ref_length,
-                            query_length,
-                            residue_matches,
-                            alignment_length,
-                            map_quality,
-                            is_reverse);
-
-                    chains[query_name].add(e);
-                }
-            }
 
-            token.resize(0);
-            n_delimiters++;
-        } else if (c == '\n') {
-            if (n_delimiters < 13) {
-                throw runtime_error("ERROR: file provided does not contain sufficient tab delimiters to be PAF");
-            }
+void AlignmentChains::add_alignment(const PafRecord& record) {
+    ChainElement e;
 
-            token.resize(0);
-            n_delimiters = 0;
-        } else {
-            token += c;
-        }
+    if (PafSource::get_element(record, contigs, e) and is_usable(e)) {
+        add(record.query_name, e);
     }
 }
 
 
-bool compare_chain_elements(ChainElement& a, ChainElement& b) {
-    auto midpoint_a = (double(a.query_stop) + double(a.query_start)) / 2;
-    auto midpoint_b = (double(b.query_stop) + double(b.query_start)) / 2;
-
-    return midpoint_a < midpoint_b;
+/// The filter that every input format goes through, so the same alignments are kept whether they are read from PAF,
+/// SAM, BAM or CRAM
+bool AlignmentChains::is_usable(const ChainElement& e) {
+    return e.map_quality > min_quality;
 }
 
 
 size_t AlignmentChain::size() const {
-    return chain.size();
+    return length;
+}
+
+
+// Chains up to this long are insertion sorted, since most reads have only a few alignments
+static const size_t insertion_sort_length = 16;
+
+// Chains at least this long are radix sorted, a digit of this many bits per pass
+static const size_t radix_sort_length = 256;
+static const uint32_t radix_bits = 11;
+
+
+/// Order two positions of order by key, breaking ties by their original position so every path gives the same result
+static inline void compare_swap(const vector<uint64_t>& keys, vector<uint32_t>& order, size_t a, size_t b) {
+    auto x = order[a];
+    auto y = order[b];
+
+    if (keys[y] < keys[x] or (keys[y] == keys[x] and y < x)) {
+        order[a] = y;
+        order[b] = x;
+    }
 }
 
 
+/// Stable LSD radix sort of order by key. Passes above the highest bit of any key are skipped, so reads under 2 Mbp take
+/// 2 passes, as do passes whose digit is the same for every key.
+static void radix_sort(const vector<uint64_t>& keys, vector<uint32_t>& order) {
+    uint64_t max_key = 0;
+
+    for (auto k: keys) {
+        max_key = max(max_key, k);
+    }
+
+    size_t n_buckets = size_t(1) << radix_bits;
+    uint64_t mask = n_buckets - 1;
+
+    vector<uint32_t> counts(n_buckets);
+    vector<uint32_t> sorted(order.size());
+
+    for (uint32_t shift=0; shift < 64 and (max_key >> shift) > 0; shift += radix_bits) {
+        std::fill(counts.begin(), counts.end(), 0);
+
+        for (auto i: order) {
+            counts[(keys[i] >> shift) & mask]++;
+        }
+
+        if (counts[(keys[order[0]] >> shift) & mask] == order.size()) {
+            continue;
+        }
+
+        uint32_t total = 0;
+
+        for (auto& c: counts) {
+            auto n = c;
+            c = total;
+            total += n;
+        }
+
+        for (auto i: order) {
+            sorted[counts[(keys[i] >> shift) & mask]++] = i;
+        }
+
+        order.swap(sorted);
+    }
+}
+
+
+/// Sort by midpoint in the query, by sorting indexes and then moving each column of the range into that order
 void AlignmentChain::sort_chain() {
-    sort(chain.begin(), chain.end(), compare_chain_elements);
+    vector<uint32_t> order;
+    sort_chain(order);
 }
 
 
-uint32_t AlignmentChain::compute_distance(ChainElement& a, ChainElement& b) {
+/// Midpoints are compared as the integer sum of start and stop, which is twice the midpoint. Ties keep their input
+/// order. The method depends on the length: single alignments and chains that are already sorted are left as they are,
+/// 2 to 4 elements go through a sorting network, short chains an insertion sort, and long ones a radix sort.
+void AlignmentChain::sort_chain(vector<uint32_t>& order) {
+    if (length < 2) {
+        order.assign(length, 0);
+        return;
+    }
+
+    vector<uint64_t> keys(length);
+    order.resize(length);
+
+    bool is_sorted = true;
+
+    for (size_t i=0; i<length; i++) {
+        keys[i] = uint64_t(store->query_starts[offset + i]) + uint64_t(store->query_stops[offset + i]);
+        order[i] = i;
+
+        if (i > 0 and keys[i] < keys[i-1]) {
+            is_sorted = false;
+        }
+    }
+
+    if (is_sorted) {
+        return;
+    }
+
+    if (length == 2) {
+        compare_swap(keys, order, 0, 1);
+    }
+    else if (length == 3) {
+        compare_swap(keys, order, 0, 1);
+        compare_swap(keys, order, 1, 2);
+        compare_swap(keys, order, 0, 1);
+    }
+    else if (length == 4) {
+        compare_swap(keys, order, 0, 1);
+        compare_swap(keys, order, 2, 3);
+        compare_swap(keys, order, 0, 2);
+        compare_swap(keys, order, 1, 3);
+        compare_swap(keys, order, 1, 2);
+    }
+    else if (length <= insertion_sort_length) {
+        for (size_t i=1; i<length; i++) {
+            auto x = order[i];
+            size_t j = i;
+
+            while (j > 0 and keys[order[j-1]] > keys[x]) {
+                order[j] = order[j-1];
+                j--;
+            }
+
+            order[j] = x;
+        }
+    }
+    else if (length < radix_sort_length) {
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){
+            return keys[a] < keys[b] or (keys[a] == keys[b] and a < b);
+        });
+    }
+    else {
+        radix_sort(keys, order);
+    }
+
+    store->permute(offset, order);
+}
+
+
+uint32_t AlignmentChain::compute_distance(size_t a, size_t b) const {
+    return compute_distance(a, b, gap_penalty);
+}
+
+
+uint32_t AlignmentChain::compute_distance(size_t a, size_t b, uint32_t contig_penalty) const {
+    a += offset;
+    b += offset;
+
     uint32_t distance = 0;
-    if (a.ref_name == b.ref_name) {
-        auto a_start = a.get_forward_start();
-        auto b_start = b.get_forward_start();
-        auto a_stop = a.get_forward_stop();
-        auto b_stop = b.get_forward_stop();
+    if (store->contig_ids[a] == store->contig_ids[b]) {
+        auto a_start = store->get_forward_start(a);
+        auto b_start = store->get_forward_start(b);
+        auto a_stop = store->get_forward_stop(a);
+        auto b_stop = store->get_forward_stop(b);
 
         // If there is any overlap, set distance to 0
         if ((a_stop > b_start and a_start < b_stop) or (b_stop > a_start and b_start < a_stop)) {
@@ -352,62 +820,91 @@ uint32_t AlignmentChain::compute_distance(ChainElement& a, ChainElement& b) {
         }
     } else {
         // If 2 successive alignments are on different contigs, find the minimum possible distance (+gap penalty)
-        int32_t a_to_end = a.distance_to_end_of_contig();
-        int32_t b_to_end = b.distance_to_end_of_contig();
-        distance = a_to_end + b_to_end + gap_penalty;
+        int32_t a_to_end = store->distance_to_end_of_contig(a);
+        int32_t b_to_end = store->distance_to_end_of_contig(b);
+        distance = a_to_end + b_to_end + contig_penalty;
     }
 
     return distance;
 }
 
 
-void AlignmentChain::split(set<pair<size_t, size_t> >& subchain_bounds, pair<size_t, size_t> bounds) {
-    // For the first recursion, load the result object
-    if (subchain_bounds.empty()) {
-        bounds = {0, chain.size()};
-        subchain_bounds.emplace(bounds);
+/// Distance between each pair of neighbouring elements, so gaps[i] is between elements i and i+1. Assumes the chain has
+/// been sorted by midpoint.
+void AlignmentChain::compute_gaps(vector<uint32_t>& gaps) const {
+    compute_gaps(gaps, gap_penalty);
+}
+
+
+void AlignmentChain::compute_gaps(vector<uint32_t>& gaps, uint32_t contig_penalty) const {
+    gaps.resize(length > 0 ? length - 1 : 0);
+
+    liger2liger::compute_gaps(*store, offset, offset + length, contig_penalty, gaps.data());
+}
+
+
+/// Split the chain at its largest gap, and then each side at its own largest gap, for as long as that gap exceeds
+/// max_gap. A range is only left whole once none of its gaps exceed max_gap, and splitting a range never changes the gaps
+/// inside either side, so the order of splits doesn't matter and every such gap ends up as a boundary. That is found in
+/// one pass over the gaps, which are each computed once, with the subchains written in query order.
+void AlignmentChain::split(vector<pair<size_t, size_t> >& subchain_bounds) const {
+    // A single alignment can't be split, which is the case for most reads
+    if (length < 2) {
+        subchain_bounds.assign(1, {0, length});
+        return;
     }
 
-    size_t start = bounds.first;
-    size_t stop = bounds.second;
+    vector<uint32_t> gaps;
+    compute_gaps(gaps);
 
-    uint32_t longest_gap = 0;
-    uint32_t gap_index;
+    split_at_gaps(gaps.data(), subchain_bounds);
+}
 
-    // Iterate and split at largest gap that passes threshold
-    // Assume chains have already been sorted by their midpoints
-    for (size_t i = start; i < stop - 1; i++) {
-        auto gap = compute_distance(chain[i], chain[i + 1]);
 
-        if (gap > longest_gap) {
-            longest_gap = gap;
-            gap_index = i + 1;
-        }
+void AlignmentChain::split(const vector<uint32_t>& store_gaps, vector<pair<size_t, size_t> >& subchain_bounds) const {
+    if (length < 2) {
+        subchain_bounds.assign(1, {0, length});
+        return;
     }
 
-    // Split the bounds if this chain contains a sufficiently large gap
-    if (longest_gap > max_gap) {
-        subchain_bounds.erase(bounds);
+    split_at_gaps(store_gaps.data() + offset, subchain_bounds);
+}
+
 
-        pair<size_t, size_t> left = {bounds.first, gap_index};
-        pair<size_t, size_t> right = {gap_index, bounds.second};
+void AlignmentChain::split_at_gaps(const uint32_t* gaps, vector<pair<size_t, size_t> >& subchain_bounds) const {
+    subchain_bounds.clear();
 
-        subchain_bounds.emplace(left);
-        subchain_bounds.emplace(right);
+    size_t start = 0;
 
-        // Recur
-        split(subchain_bounds, left);
-        split(subchain_bounds, right);
+    for (size_t i=0; i+1 < length; i++) {
+        if (gaps[i] > max_gap) {
+            subchain_bounds.emplace_back(start, i + 1);
+            start = i + 1;
+        }
     }
+
+    subchain_bounds.emplace_back(start, length);
+}
+
+
+/// Gaps of every chain at once, in one pass of the gap kernel over the whole store, which is grouped first. Every chain
+/// must already be sorted. Gaps that span the end of one chain and the start of the next are left in place, and ignored
+/// by AlignmentChain::split.
+void AlignmentChains::compute_gaps(vector<uint32_t>& gaps) {
+    elements.group_by_read(read_names.size());
+
+    gaps.resize(elements.size());
+
+    liger2liger::compute_gaps(elements, 0, elements.size(), AlignmentChain::gap_penalty, gaps.data());
 }
 
 
 void AlignmentChains::split_all_chains() {
-    for (auto&[name, chain]: chains) {
+    for_each_chain([&](string_view name, AlignmentChain& chain) {
 
         cerr << "before sorting:" << '\n';
-        for (auto& item: chain.chain) {
-            cerr << item << '\n';
+        for (size_t i=0; i<chain.size(); i++) {
+            cerr << chain[i] << '\n';
         }
         cerr << '\n';
 
@@ -415,17 +912,17 @@ void AlignmentChains::split_all_chains() {
         chain.sort_chain();
 
         cerr << "after sorting:" << '\n';
-        for (auto& item: chain.chain) {
-            cerr << item << '\n';
+        for (size_t i=0; i<chain.size(); i++) {
+            cerr << chain[i] << '\n';
         }
         cerr << '\n';
 
-        // Do recursive splitting
-        set<pair<size_t, size_t> > subchain_bounds;
+        // Split at every large gap
+        vector<pair<size_t, size_t> > subchain_bounds;
         chain.split(subchain_bounds);
 
         print_subchains(chain, subchain_bounds, name);
-    }
+    });
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,467 @@
+#include "AlignmentSource.hpp"
+#include "AlignmentChain.hpp"
+#include "DelimiterScanner.hpp"
+
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cctype>
+#include <mutex>
+#include <map>
+
+using std::condition_variable;
+using std::runtime_error;
+using std::unique_lock;
+using std::mutex;
+using std::map;
+
+
+namespace liger2liger{
+
+
+// Elements per batch of the sources that convert on the calling thread. Large enough that the cost of handing over a
+// batch is negligible, and small enough that a batch stays in cache.
+static const size_t source_batch_size = 1024;
+
+// Converted batches that the BAM pipeline may hold ahead of next_batch, per converting thread
+static const size_t converted_batches_per_worker = 2;
+
+
+void AlignmentBatch::add(string_view name, const ChainElement& e){
+    elements.emplace_back(e);
+    names += name;
+    name_stops.emplace_back(names.size());
+}
+
+
+string_view AlignmentBatch::get_name(size_t i) const{
+    size_t start = (i == 0) ? 0 : name_stops[i-1];
+    return string_view(names).substr(start, name_stops[i] - start);
+}
+
+
+size_t AlignmentBatch::size() const{
+    return elements.size();
+}
+
+
+void AlignmentBatch::clear(){
+    elements.clear();
+    names.clear();
+    name_stops.clear();
+}
+
+
+void CigarSpans::add(uint32_t op, uint32_t length, bool is_first) {
+    switch (op) {
+        case BAM_CMATCH:
+        case BAM_CEQUAL:
+        case BAM_CDIFF:
+            n_matches += length;
+            break;
+        case BAM_CINS:
+            n_inserts += length;
+            break;
+        case BAM_CDEL:
+            n_deletes += length;
+            break;
+        case BAM_CSOFT_CLIP:
+        case BAM_CHARD_CLIP:
+            if (is_first) {
+                start_clip = length;
+            }
+            else {
+                end_clip = length;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+
+bool CigarSpans::add(string_view cigar) {
+    bool is_first = true;
+
+    // Each operation is a run of digits followed by its character
+    while (not cigar.empty()) {
+        uint32_t length = 0;
+        size_t i = 0;
+
+        while (i < cigar.size() and isdigit(cigar[i])) {
+            length = length*10 + uint32_t(cigar[i] - '0');
+            i++;
+        }
+
+        auto op = (i < cigar.size()) ? strchr(BAM_CIGAR_STR, cigar[i]) : nullptr;
+
+        if (i == 0 or op == nullptr or *op == '\0') {
+            return false;
+        }
+
+        add(uint32_t(op - BAM_CIGAR_STR), length, is_first);
+        cigar.remove_prefix(i + 1);
+        is_first = false;
+    }
+
+    return true;
+}
+
+
+void CigarSpans::add(const bam1_t* record) {
+    auto cigar = bam_get_cigar(record);
+
+    for (uint32_t i=0; i<record->core.n_cigar; i++) {
+        add(bam_cigar_op(cigar[i]), bam_cigar_oplen(cigar[i]), i == 0);
+    }
+}
+
+
+ChainElement CigarSpans::get_element(
+        uint32_t contig_id,
+        uint32_t ref_start,
+        uint32_t ref_length,
+        uint32_t map_quality,
+        bool is_reverse) const {
+
+    uint32_t query_length = n_matches + n_inserts + start_clip + end_clip;
+
+    return {
+            contig_id,
+            ref_start,
+            ref_start + n_matches + n_deletes,
+            is_reverse ? end_clip : start_clip,
+            query_length - (is_reverse ? start_clip : end_clip),
+            ref_length,
+            query_length,
+            n_matches,
+            n_matches + n_inserts + n_deletes,
+            map_quality,
+            is_reverse};
+}
+
+
+uint32_t TargetContigIds::get_id(int32_t tid, const bam_hdr_t* header, ContigTable& contigs) {
+    // Ref name field might be empty if read is unmapped, in which case the target (aka ref) id might not be in range
+    if (tid > -1 and tid < header->n_targets) {
+        if (contig_ids.empty()) {
+            contig_ids.resize(header->n_targets, UINT32_MAX);
+        }
+
+        if (contig_ids[tid] == UINT32_MAX) {
+            contig_ids[tid] = contigs.get_id(header->target_name[tid], header->target_len[tid]);
+        }
+
+        return contig_ids[tid];
+    }
+
+    if (unmapped_contig_id == UINT32_MAX) {
+        unmapped_contig_id = contigs.get_id("", 0);
+    }
+
+    return unmapped_contig_id;
+}
+
+
+uint32_t TargetContigIds::get_length(int32_t tid, const bam_hdr_t* header) {
+    if (tid > -1 and tid < header->n_targets) {
+        return header->target_len[tid];
+    }
+
+    return 0;
+}
+
+
+ChainElement TargetContigIds::get_element(const bam1_t* record, const bam_hdr_t* header, ContigTable& contigs) {
+    CigarSpans spans;
+    spans.add(record);
+
+    auto tid = record->core.tid;
+
+    return spans.get_element(
+            get_id(tid, header, contigs),
+            uint32_t(record->core.pos),
+            get_length(tid, header),
+            record->core.qual,
+            bam_is_rev(record));
+}
+
+
+ChainElement get_sa_element(string_view read_name, const SaEntry& entry, uint32_t contig_id, uint32_t ref_length){
+    CigarSpans spans;
+
+    if (not spans.add(entry.cigar)) {
+        throw runtime_error("ERROR: SA tag of read " + string(read_name) + " has invalid CIGAR: " + string(entry.cigar));
+    }
+
+    return spans.get_element(contig_id, uint32_t(entry.ref_start), ref_length, entry.map_quality, entry.is_reverse);
+}
+
+
+bool PafSource::get_element(const PafRecord& record, ContigTable& contigs, ChainElement& e){
+    // Aligners that don't report the cm:i: tag can't be filtered by it
+    int64_t n_minimizers = int64_t(AlignmentChains::min_chain_minimizers) + 1;
+    record.tags.get_int(PafTags::n_minimizers, n_minimizers);
+
+    if (n_minimizers <= AlignmentChains::min_chain_minimizers) {
+        return false;
+    }
+
+    e = {
+        contigs.get_id(record.ref_name, record.ref_length),
+        record.ref_start,
+        record.ref_stop,
+        record.query_start,
+        record.query_stop,
+        record.ref_length,
+        record.query_length,
+        record.residue_matches,
+        record.alignment_length,
+        record.map_quality,
+        record.is_reverse};
+
+    return true;
+}
+
+
+/// Parse a line of either PAF source into record, and add its element to batch unless it is filtered
+static void add_paf_line(string_view line, PafRecord& record, AlignmentBatch& batch, ContigTable& contigs){
+    if (line.empty()) {
+        return;
+    }
+
+    if (not parse_paf_line(line, record)) {
+        throw runtime_error("ERROR: file provided does not contain sufficient tab delimiters to be PAF");
+    }
+
+    ChainElement e;
+
+    if (PafSource::get_element(record, contigs, e)) {
+        batch.add(record.query_name, e);
+    }
+}
+
+
+PafSource::PafSource(path paf_path, size_t n_threads):
+    file(paf_path, n_threads)
+{}
+
+
+bool PafSource::next_batch(AlignmentBatch& batch, ContigTable& contigs){
+    batch.clear();
+
+    string_view line;
+
+    while (batch.size() < source_batch_size and file.next_line(line)) {
+        add_paf_line(line, record, batch, contigs);
+    }
+
+    return batch.size() > 0;
+}
+
+
+PafBufferSource::PafBufferSource(string_view buffer):
+    buffer(buffer)
+{}
+
+
+/// Lines are cut off the front of the buffer as they are parsed. A trailing line without '\n' is included.
+bool PafBufferSource::next_batch(AlignmentBatch& batch, ContigTable& contigs){
+    batch.clear();
+
+    while (batch.size() < source_batch_size and not buffer.empty()) {
+        auto begin = buffer.data();
+        auto end = begin + buffer.size();
+        auto newline = find_delimiter(begin, end, '\n');
+
+        add_paf_line(string_view(begin, newline - begin), record, batch, contigs);
+
+        buffer.remove_prefix(std::min(size_t(newline - begin) + 1, buffer.size()));
+    }
+
+    return batch.size() > 0;
+}
+
+
+SamSource::SamSource(path sam_path, size_t n_threads):
+    reader(sam_path, n_threads)
+{}
+
+
+ChainElement SamSource::get_element(const SamRecord& record, const SamReader& reader, ContigTable& contigs){
+    CigarSpans spans;
+
+    // Unmapped records have no CIGAR ("*"), and are kept like they are for BAM
+    if (record.cigar != "*" and not spans.add(record.cigar)) {
+        throw runtime_error("ERROR: read " + string(record.query_name) + " has invalid CIGAR: " + string(record.cigar));
+    }
+
+    auto ref_length = reader.get_ref_length(record.ref_name);
+    auto ref_name = (record.ref_name == "*") ? string_view() : record.ref_name;
+
+    return spans.get_element(
+            contigs.get_id(ref_name, ref_length),
+            uint32_t(record.ref_start),
+            ref_length,
+            record.map_quality,
+            record.is_reverse());
+}
+
+
+bool SamSource::next_batch(AlignmentBatch& batch, ContigTable& contigs){
+    batch.clear();
+
+    while (batch.size() < source_batch_size and reader.next_record(record)) {
+        batch.add(record.query_name, get_element(record, reader, contigs));
+    }
+
+    return batch.size() > 0;
+}
+
+
+BamSource::BamSource(path bam_path, size_t n_threads, path reference_path, size_t n_workers):
+    n_workers(n_workers),
+    reader(bam_path, n_threads, reference_path),
+    converted_batches(converted_batches_per_worker*std::max(n_workers, size_t(1)))
+{
+    if (n_workers > 0) {
+        pipeline = thread([this](){
+            try {
+                convert_batches();
+            }
+            catch (...) {
+                pipeline_exception = std::current_exception();
+            }
+
+            converted_batches.close();
+        });
+    }
+}
+
+
+BamSource::~BamSource(){
+    // If the caller stops early, the pipeline fails at its next hand over, and stops
+    converted_batches.close();
+
+    if (pipeline.joinable()) {
+        pipeline.join();
+    }
+}
+
+
+/// Convert the records of each batch that the reader decodes, on the reader's workers, and queue them in input order.
+/// Contig ids are only assigned, from the target ids, by next_batch. The reader hands out batches in order, so the next
+/// batch is always held by a worker that is not waiting, and waiting on it can't deadlock.
+void BamSource::convert_batches(){
+    mutex pending_mutex;
+    condition_variable pending_shrunk;
+    map<size_t, AlignmentBatch> pending;
+    size_t next_index = 0;
+    bool is_queueing = false;
+    bool failed = false;
+
+    reader.for_record_batch_in_bam(n_workers, [&](const BamRecordBatch& batch, const bam_hdr_t* header){
+        AlignmentBatch converted;
+
+        converted.elements.reserve(batch.size);
+        converted.name_stops.reserve(batch.size);
+
+        for (size_t i=0; i<batch.size; i++) {
+            auto record = batch.records[i];
+            auto tid = record->core.tid;
+
+            CigarSpans spans;
+            spans.add(record);
+
+            converted.add(bam_get_qname(record), spans.get_element(
+                    uint32_t(tid),
+                    uint32_t(record->core.pos),
+                    TargetContigIds::get_length(tid, header),
+                    record->core.qual,
+                    bam_is_rev(record)));
+        }
+
+        unique_lock<mutex> lock(pending_mutex);
+        pending.emplace(batch.index, std::move(converted));
+
+        // Another worker is queueing batches and will queue this one too once it is next, or this batch is not next and
+        // will be queued by whichever worker converts the one that is. Either way, while n_workers batches are already
+        // pending, this worker holds on to its records until the batch the queue needs next has been handed off, which
+        // keeps the reader from running further ahead and bounds the pending batches to about 2*n_workers.
+        if (is_queueing or pending.begin()->first != next_index) {
+            pending_shrunk.wait(lock, [&](){
+                return failed or pending.size() < n_workers;
+            });
+
+            return;
+        }
+
+        is_queueing = true;
+
+        try {
+            while (not pending.empty() and pending.begin()->first == next_index) {
+                auto next = std::move(pending.begin()->second);
+                pending.erase(pending.begin());
+                lock.unlock();
+
+                if (not converted_batches.push(std::move(next))) {
+                    throw runtime_error("ERROR: BAM conversion stopped before the end of the input");
+                }
+
+                lock.lock();
+                next_index++;
+                pending_shrunk.notify_all();
+            }
+        }
+        catch (...) {
+            if (not lock.owns_lock()) {
+                lock.lock();
+            }
+
+            failed = true;
+            pending_shrunk.notify_all();
+            throw;
+        }
+
+        is_queueing = false;
+    });
+}
+
+
+bool BamSource::next_batch(AlignmentBatch& batch, ContigTable& contigs){
+    auto header = reader.get_header();
+
+    if (n_workers == 0) {
+        batch.clear();
+
+        const bam1_t* record;
+
+        while (batch.size() < source_batch_size and (record = reader.next_record()) != nullptr) {
+            batch.add(bam_get_qname(record), target_contig_ids.get_element(record, header, contigs));
+        }
+
+        return batch.size() > 0;
+    }
+
+    if (not converted_batches.pop(batch)) {
+        if (pipeline.joinable()) {
+            pipeline.join();
+        }
+
+        if (pipeline_exception) {
+            std::rethrow_exception(pipeline_exception);
+        }
+
+        return false;
+    }
+
+    for (auto& e: batch.elements) {
+        e.contig_id = target_contig_ids.get_id(int32_t(e.contig_id), header, contigs);
+    }
+
+    return true;
+}
+
+
+}
@@ -1,39 +1,110 @@
 #include "AlignmentChain.hpp"
+#include "BoundedQueue.hpp"
 #include "Bam.hpp"
+#include "ReadGroupFilter.hpp"
 
+#include <string_view>
+#include <algorithm>
+#include <charconv>
+#include <limits>
 #include <stdexcept>
+#include <exception>
 #include <iostream>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
 #include <vector>
+#include <string>
 
+using std::unordered_set;
 using std::runtime_error;
+using std::exception_ptr;
+using std::atomic;
+using std::thread;
 using std::vector;
+using std::string_view;
+using std::to_string;
 using std::cerr;
 
 
 namespace liger2liger{
 
 
-Bam::Bam(path bam_path):
+// Fields that chain elements are built from. Sequence and qualities are never needed, and leaving them out means CRAM
+// records don't have to be reconstructed from the reference.
+static const int chain_fields = SAM_QNAME | SAM_FLAG | SAM_RNAME | SAM_POS | SAM_MAPQ | SAM_CIGAR;
+
+// Fields that point to the other alignments of a read: the SA tag, and the mate's position
+static const int linked_fields = SAM_AUX | SAM_RNEXT | SAM_PNEXT;
+
+// Records per batch of for_record_batch_in_bam, and batches in its pool per worker, which is enough for every worker to
+// have one batch in hand and another queued while the reader fills a third
+static const size_t batch_size = 1024;
+static const size_t batches_per_worker = 3;
+
+
+Bam::Bam(path bam_path, size_t n_threads, path reference_path):
     bam_path(bam_path),
+    reference_path(reference_path),
+    n_threads(n_threads),
     bam_file(nullptr),
-//    bam_index(nullptr),
-    bam_iterator(nullptr)
+    bam_header(nullptr),
+    bam_index(nullptr),
+    bam_iterator(nullptr),
+    alignment(nullptr),
+    thread_pool({nullptr, 0}),
+    is_cram(false)
 {
-    if ((bam_file = hts_open(bam_path.string().c_str(), "r")) == 0) {
-        throw runtime_error("ERROR: Cannot open bam file: " + bam_path.string());
-    }
+    // The destructor doesn't run if the constructor throws, so whatever was opened before the error is closed here
+    try {
+        if ((bam_file = hts_open(bam_path.string().c_str(), "r")) == 0) {
+            throw runtime_error("ERROR: Cannot open bam file: " + bam_path.string());
+        }
 
-//    // bam index
-//    if ((bam_index = sam_index_load(bam_file, bam_path.string().c_str())) == 0) {
-//        throw runtime_error("ERROR: Cannot open index for bam file: " + bam_path.string() + "\n");
-//    }
+        is_cram = (hts_get_format(bam_file)->format == cram);
 
-    // bam header
-    if ((bam_header = sam_hdr_read(bam_file)) == 0){
-        throw runtime_error("ERROR: Cannot open header for bam file: " + bam_path.string() + "\n");
-    }
+        if (not reference_path.empty()) {
+            if (not is_cram) {
+                throw runtime_error("ERROR: a reference can only be used with CRAM input, not: " + bam_path.string());
+            }
 
-    alignment = bam_init1();
+            if (not ghc::filesystem::exists(reference_path)) {
+                throw runtime_error("ERROR: reference file not found: " + reference_path.string());
+            }
+
+            if (hts_set_fai_filename(bam_file, reference_path.string().c_str()) < 0) {
+                throw runtime_error("ERROR: Cannot use reference for cram file: " + reference_path.string());
+            }
+        }
+
+        if (is_cram) {
+            // MD and NM would otherwise be recomputed from the reference for every record
+            hts_set_opt(bam_file, CRAM_OPT_DECODE_MD, 0);
+            set_cram_required_fields(chain_fields);
+        }
+
+        // BGZF blocks are independent, so the pool inflates upcoming blocks while the current one is parsed
+        if (n_threads > 1) {
+            if ((thread_pool.pool = hts_tpool_init(int(n_threads))) == nullptr) {
+                throw runtime_error("ERROR: Cannot start " + to_string(n_threads) + " decompression threads");
+            }
+
+            if (hts_set_thread_pool(bam_file, &thread_pool) < 0) {
+                throw runtime_error("ERROR: Cannot use decompression threads for bam file: " + bam_path.string());
+            }
+        }
+
+        // bam header
+        if ((bam_header = sam_hdr_read(bam_file)) == 0){
+            throw runtime_error("ERROR: Cannot open header for bam file: " + bam_path.string() + "\n");
+        }
+
+        alignment = bam_init1();
+    }
+    catch (...) {
+        close();
+        throw;
+    }
 }
 
 
@@ -81,6 +152,464 @@ void Bam::for_alignment_in_bam(bool get_cigar, const function<void(SamElement& a
 }
 
 
+void Bam::for_record_in_bam(const function<void(const bam1_t* record, const bam_hdr_t* header)>& f){
+    while (sam_read1(bam_file, bam_header, alignment) >= 0){
+        f(alignment, bam_header);
+    }
+}
+
+
+const bam1_t* Bam::next_record(){
+    auto status = sam_read1(bam_file, bam_header, alignment);
+
+    if (status < -1) {
+        throw runtime_error("ERROR: Cannot decode record in bam file: " + bam_path.string());
+    }
+
+    return (status >= 0) ? alignment : nullptr;
+}
+
+
+void Bam::for_primary_record_in_bam(const function<void(const bam1_t* record, const bam_hdr_t* header)>& f){
+    if (is_cram) {
+        set_cram_required_fields(chain_fields | SAM_AUX);
+    }
+
+    while (sam_read1(bam_file, bam_header, alignment) >= 0){
+        if (alignment->core.flag & (BAM_FSECONDARY | BAM_FSUPPLEMENTARY)) {
+            continue;
+        }
+
+        f(alignment, bam_header);
+    }
+}
+
+
+void Bam::for_sa_entry(const bam1_t* record, const function<void(const SaEntry& entry)>& f){
+    auto sa_tag = bam_aux_get(record, "SA");
+
+    if (sa_tag != nullptr) {
+        liger2liger::for_sa_entry(bam_aux2Z(sa_tag), f);
+    }
+}
+
+
+void for_sa_entry(string_view sa_tag, const function<void(const SaEntry& entry)>& f){
+    // rname,pos,strand,CIGAR,mapQ,NM; with a 1-based pos, repeated for each other alignment
+    string_view entries = sa_tag;
+    SaEntry entry;
+
+    auto parse_number = [](string_view field, auto& value){
+        auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+        return result.ec == std::errc() and result.ptr == field.data() + field.size();
+    };
+
+    while (not entries.empty()) {
+        auto end = std::min(entries.find(';'), entries.size());
+        auto text = entries.substr(0, end);
+        entries.remove_prefix(std::min(end + 1, entries.size()));
+
+        string_view fields[6];
+        size_t n_fields = 0;
+
+        while (n_fields < 6) {
+            auto comma = std::min(text.find(','), text.size());
+            fields[n_fields++] = text.substr(0, comma);
+
+            if (comma == text.size()) {
+                break;
+            }
+
+            text.remove_prefix(comma + 1);
+        }
+
+        uint32_t map_quality;
+
+        if (n_fields < 6 or fields[2].size() != 1 or fields[3].empty() or
+            not parse_number(fields[1], entry.ref_start) or
+            not parse_number(fields[4], map_quality) or
+            not parse_number(fields[5], entry.edit_distance)) {
+            continue;
+        }
+
+        entry.ref_name = fields[0];
+        entry.ref_start--;
+        entry.is_reverse = (fields[2][0] == '-');
+        entry.cigar = fields[3];
+        entry.map_quality = uint8_t(std::min(map_quality, uint32_t(255)));
+
+        f(entry);
+    }
+}
+
+
+void Bam::for_record_batch_in_bam(
+        size_t n_workers,
+        const function<void(const BamRecordBatch& batch, const bam_hdr_t* header)>& f){
+
+    if (n_workers == 0) {
+        throw runtime_error("ERROR: cannot read bam file with 0 workers: " + bam_path.string());
+    }
+
+    size_t n_batches = batches_per_worker*n_workers;
+
+    vector<BamRecordBatch> batches(n_batches);
+    BoundedQueue<BamRecordBatch*> free_batches(n_batches);
+    BoundedQueue<BamRecordBatch*> full_batches(n_batches);
+
+    for (auto& batch: batches) {
+        batch.records.resize(batch_size);
+
+        for (auto& record: batch.records) {
+            record = bam_init1();
+        }
+
+        free_batches.push(&batch);
+    }
+
+    // The first exception on any thread stops the reader, and is rethrown once every thread has stopped
+    vector<exception_ptr> exceptions(n_workers + 1);
+    atomic<bool> failed(false);
+
+    thread reader([&](){
+        try {
+            BamRecordBatch* batch;
+            size_t index = 0;
+            int status = 0;
+
+            while (status >= 0 and not failed and free_batches.pop(batch)) {
+                batch->size = 0;
+                batch->index = index++;
+
+                while (batch->size < batch_size and (status = sam_read1(bam_file, bam_header, batch->records[batch->size])) >= 0) {
+                    batch->size++;
+                }
+
+                if (status < -1) {
+                    throw runtime_error("ERROR: Cannot decode record in bam file: " + bam_path.string());
+                }
+
+                if (batch->size > 0) {
+                    full_batches.push(batch);
+                }
+            }
+        }
+        catch (...) {
+            exceptions[n_workers] = std::current_exception();
+            failed = true;
+        }
+
+        full_batches.close();
+    });
+
+    vector<thread> workers;
+
+    for (size_t i=0; i<n_workers; i++) {
+        workers.emplace_back([&, i](){
+            BamRecordBatch* batch;
+
+            while (full_batches.pop(batch)) {
+                // Keep draining after a failure, so the reader is never left waiting for a free batch
+                if (not failed) {
+                    try {
+                        f(*batch, bam_header);
+                    }
+                    catch (...) {
+                        exceptions[i] = std::current_exception();
+                        failed = true;
+                    }
+                }
+
+                free_batches.push(batch);
+            }
+        });
+    }
+
+    reader.join();
+
+    for (auto& t: workers) {
+        t.join();
+    }
+
+    for (auto& batch: batches) {
+        for (auto& record: batch.records) {
+            bam_destroy1(record);
+        }
+    }
+
+    for (auto& e: exceptions) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+
+void Bam::for_read_in_bam(const function<void(const BamRecordBatch& records, const bam_hdr_t* header)>& f){
+    BamRecordBatch read;
+    read.size = 0;
+    read.index = 0;
+
+    auto not_grouped_error = [&](const string& name){
+        return runtime_error("ERROR: records of read " + name + " are not adjacent in " + bam_path.string() +
+                             ". Sort it by name first, e.g. with samtools sort -n");
+    };
+
+    ReadGroupFilter closed_reads;
+
+    // Only the names are needed, so the records can be read again with one reused bam1_t
+    auto verify_suspects = [&](){
+        Bam verifier(bam_path, n_threads, reference_path);
+
+        for (auto r = verifier.next_record(); r != nullptr; r = verifier.next_record()) {
+            string_view name = bam_get_qname(r);
+
+            if (not closed_reads.verify(name)) {
+                throw not_grouped_error(string(name));
+            }
+        }
+
+        closed_reads.end_verifying();
+    };
+
+    auto close_read = [&](){
+        closed_reads.close(bam_get_qname(read.records[0]));
+        f(read, bam_header);
+        read.index++;
+    };
+
+    while (true) {
+        if (read.size == read.records.size()) {
+            read.records.emplace_back(bam_init1());
+        }
+
+        auto record = read.records[read.size];
+        auto status = sam_read1(bam_file, bam_header, record);
+
+        if (status < -1) {
+            throw runtime_error("ERROR: Cannot decode record in bam file: " + bam_path.string());
+        }
+
+        if (status < 0) {
+            break;
+        }
+
+        string_view name = bam_get_qname(record);
+
+        if (read.size > 0 and name != bam_get_qname(read.records[0])) {
+            close_read();
+
+            if (closed_reads.may_be_closed(name)) {
+                if (bam_path == "-") {
+                    throw not_grouped_error(string(name) + " (or a read whose name hash collides with it)");
+                }
+
+                verify_suspects();
+            }
+
+            // The new read starts with the record that was just read
+            std::swap(read.records[0], read.records[read.size]);
+            read.size = 0;
+        }
+
+        read.size++;
+    }
+
+    if (read.size > 0) {
+        close_read();
+    }
+
+    for (auto& record: read.records) {
+        bam_destroy1(record);
+    }
+}
+
+
+const bam_hdr_t* Bam::get_header() const{
+    return bam_header;
+}
+
+
+void Bam::require_all_fields(){
+    if (is_cram) {
+        set_cram_required_fields(chain_fields | linked_fields | SAM_TLEN | SAM_SEQ | SAM_QUAL | SAM_RGAUX);
+    }
+}
+
+
+htsThreadPool* Bam::get_thread_pool(){
+    return thread_pool.pool == nullptr ? nullptr : &thread_pool;
+}
+
+
+/// Limit CRAM decoding to these SAM_* fields. Must be called before the first record is read.
+void Bam::set_cram_required_fields(int fields){
+    if (hts_set_opt(bam_file, CRAM_OPT_REQUIRED_FIELDS, fields) < 0) {
+        throw runtime_error("ERROR: Cannot set required fields for cram file: " + bam_path.string());
+    }
+}
+
+
+/// The index is only needed for region queries, so it is loaded on first use
+void Bam::load_index(){
+    if (bam_index != nullptr) {
+        return;
+    }
+
+    if ((bam_index = sam_index_load(bam_file, bam_path.string().c_str())) == 0) {
+        throw runtime_error("ERROR: Cannot open index for bam file: " + bam_path.string() + "\n");
+    }
+}
+
+
+/// Visit the records overlapping [start, stop) of one target, in the reused alignment
+void Bam::for_record_in_interval(int32_t tid, int64_t start, int64_t stop, const function<void()>& f){
+    hts_itr_destroy(bam_iterator);
+    bam_iterator = nullptr;
+
+    // Positions that htslib can't represent can't hold any records either, so the query stops at the largest one
+    const int64_t max_position = std::numeric_limits<HtsPosition>::max();
+
+    if (start >= max_position) {
+        return;
+    }
+
+    stop = std::min(stop, max_position);
+
+    if ((bam_iterator = sam_itr_queryi(bam_index, tid, HtsPosition(start), HtsPosition(stop))) == nullptr) {
+        throw runtime_error("ERROR: Cannot query region " + string(bam_header->target_name[tid]) + ":" +
+                            to_string(start + 1) + "-" + to_string(stop) + " in bam file: " + bam_path.string());
+    }
+
+    int result;
+
+    while ((result = sam_itr_next(bam_file, bam_iterator, alignment)) >= 0) {
+        f();
+    }
+
+    if (result < -1) {
+        throw runtime_error("ERROR: Cannot read region " + string(bam_header->target_name[tid]) + " in bam file: " +
+                            bam_path.string());
+    }
+}
+
+
+/// Record where the other alignments of the current record's read start: every entry of its SA tag, and its mate
+void Bam::add_linked_positions(map<pair<int32_t, int64_t>, unordered_set<string> >& linked) const{
+    string query_name = bam_get_qname(alignment);
+
+    for_sa_entry(alignment, [&](const SaEntry& entry){
+        auto tid = bam_name2id(bam_header, entry.ref_name.c_str());
+
+        if (tid >= 0 and entry.ref_start >= 0) {
+            linked[{tid, entry.ref_start}].emplace(query_name);
+        }
+    });
+
+    if ((alignment->core.flag & BAM_FPAIRED) and alignment->core.mtid >= 0) {
+        linked[{alignment->core.mtid, alignment->core.mpos}].emplace(query_name);
+    }
+}
+
+
+void Bam::for_record_in_regions(
+        const vector<Region>& regions,
+        bool include_linked,
+        const function<void(const bam1_t* record, const bam_hdr_t* header)>& f){
+
+    load_index();
+
+    if (is_cram and include_linked) {
+        set_cram_required_fields(chain_fields | linked_fields);
+    }
+
+    // Sorted intervals of each target, with overlapping or touching regions merged
+    vector<vector<pair<int64_t, int64_t> > > intervals(bam_header->n_targets);
+
+    for (auto& region: regions) {
+        auto tid = bam_name2id(bam_header, region.contig.c_str());
+
+        if (tid < 0) {
+            throw runtime_error("ERROR: region contig not found in bam header: " + region.contig);
+        }
+
+        intervals[tid].emplace_back(region.start, std::min(region.stop, int64_t(bam_header->target_len[tid])));
+    }
+
+    for (auto& target_intervals: intervals) {
+        std::sort(target_intervals.begin(), target_intervals.end());
+
+        vector<pair<int64_t, int64_t> > merged;
+
+        for (auto& interval: target_intervals) {
+            if (not merged.empty() and interval.first <= merged.back().second) {
+                merged.back().second = std::max(merged.back().second, interval.second);
+            }
+            else {
+                merged.emplace_back(interval);
+            }
+        }
+
+        target_intervals = std::move(merged);
+    }
+
+    // Start positions of the linked alignments, with the names of the reads expected at each
+    map<pair<int32_t, int64_t>, unordered_set<string> > linked;
+
+    for (int32_t tid=0; tid<int32_t(intervals.size()); tid++) {
+        int64_t previous_stop = -1;
+
+        for (auto& [start, stop]: intervals[tid]) {
+            for_record_in_interval(tid, start, stop, [&](){
+                // A record that starts before this interval and overlaps it also overlapped the previous one, because
+                // merged intervals don't touch, so it has already been visited
+                if (alignment->core.pos < previous_stop) {
+                    return;
+                }
+
+                f(alignment, bam_header);
+
+                if (include_linked) {
+                    add_linked_positions(linked);
+                }
+            });
+
+            previous_stop = stop;
+        }
+    }
+
+    auto overlaps_region = [&](int32_t tid, int64_t start, int64_t stop){
+        auto& target_intervals = intervals[tid];
+
+        // First interval that ends after the start
+        auto result = std::upper_bound(target_intervals.begin(), target_intervals.end(), start,
+                [](int64_t position, const pair<int64_t, int64_t>& interval){
+            return position < interval.second;
+        });
+
+        return result != target_intervals.end() and result->first < stop;
+    };
+
+    // Each linked position is queried once, so each linked record is found at most once
+    for (auto& [position, names]: linked) {
+        auto& [tid, start] = position;
+
+        for_record_in_interval(tid, start, start + 1, [&](){
+            if (alignment->core.pos != start or names.count(bam_get_qname(alignment)) == 0) {
+                return;
+            }
+
+            // Records that overlap a region were visited in the first pass
+            if (overlaps_region(tid, alignment->core.pos, bam_endpos(alignment))) {
+                return;
+            }
+
+            f(alignment, bam_header);
+        });
+    }
+}
+
+
 //void Bam::for_alignment_in_bam(bool get_cigar, const function<void(ChainElement& alignment)>& f){
 //    while (sam_read1(bam_file, bam_header, alignment) >= 0){
 //        ChainElement e;
@@ -110,11 +639,31 @@ void Bam::for_alignment_in_bam(bool get_cigar, const function<void(SamElement& a
 
 
 Bam::~Bam() {
-    hts_close(bam_file);
-    bam_hdr_destroy(bam_header);
-    bam_destroy1(alignment);
-//    hts_idx_destroy(bam_index);
+    close();
+}
+
+
+void Bam::close() {
+    if (bam_file != nullptr) {
+        hts_close(bam_file);
+    }
+    if (bam_header != nullptr) {
+        bam_hdr_destroy(bam_header);
+    }
+    if (alignment != nullptr) {
+        bam_destroy1(alignment);
+    }
+
     hts_itr_destroy(bam_iterator);
+
+    if (bam_index != nullptr) {
+        hts_idx_destroy(bam_index);
+    }
+
+    // The file's decompression queue has to be closed before its pool
+    if (thread_pool.pool != nullptr) {
+        hts_tpool_destroy(thread_pool.pool);
+    }
 }
 
 
@@ -143,5 +692,44 @@ bool Bam::is_supplementary(uint16_t flag){
 }
 
 
+BamWriter::BamWriter(path bam_path, Bam& input):
+    bam_path(bam_path),
+    bam_file(nullptr),
+    bam_header(input.get_header())
+{
+    input.require_all_fields();
+
+    if ((bam_file = hts_open(bam_path.string().c_str(), "wb")) == nullptr) {
+        throw runtime_error("ERROR: Cannot open bam file for writing: " + bam_path.string());
+    }
+
+    // BGZF blocks are compressed by the pool while the next ones are filled
+    auto pool = input.get_thread_pool();
+
+    if (pool != nullptr and hts_set_thread_pool(bam_file, pool) < 0) {
+        hts_close(bam_file);
+        throw runtime_error("ERROR: Cannot use compression threads for bam file: " + bam_path.string());
+    }
+
+    if (sam_hdr_write(bam_file, bam_header) < 0) {
+        hts_close(bam_file);
+        throw runtime_error("ERROR: Cannot write header to bam file: " + bam_path.string());
+    }
+}
+
+
+BamWriter::~BamWriter(){
+    if (hts_close(bam_file) < 0) {
+        cerr << "ERROR: Cannot finish writing bam file: " << bam_path << '\n';
+    }
+}
+
+
+void BamWriter::write(const bam1_t* record){
+    if (sam_write1(bam_file, bam_header, record) < 0) {
+        throw runtime_error("ERROR: Cannot write record to bam file: " + bam_path.string());
+    }
+}
+
 
 }
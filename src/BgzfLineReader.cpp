@@ -0,0 +1,59 @@
+#include "BgzfLineReader.hpp"
+
+#include <stdexcept>
+
+using std::runtime_error;
+
+
+namespace liger2liger{
+
+
+BgzfLineReader::BgzfLineReader(path file_path, size_t n_threads):
+    file_path(file_path),
+    file(nullptr),
+    line({0, 0, nullptr})
+{
+    // htslib opens stdin for "-", and detects whether the input is compressed, and how, from its first bytes
+    if ((file = bgzf_open(file_path.string().c_str(), "r")) == nullptr) {
+        throw runtime_error("ERROR: could not open input file: " + file_path.string());
+    }
+
+    // Only BGZF is made of independent blocks that can be inflated in parallel
+    if (n_threads > 1 and file->is_compressed and not file->is_gzip) {
+        if (bgzf_mt(file, int(n_threads), 256) < 0) {
+            bgzf_close(file);
+            throw runtime_error("ERROR: could not start decompression threads for file: " + file_path.string());
+        }
+    }
+}
+
+
+BgzfLineReader::~BgzfLineReader(){
+    bgzf_close(file);
+    free(line.s);
+}
+
+
+bool BgzfLineReader::next_line(string_view& result){
+    auto status = bgzf_getline(file, '\n', &line);
+
+    if (status < -1) {
+        throw runtime_error("ERROR: could not decompress input file: " + file_path.string());
+    }
+
+    if (status == -1) {
+        return false;
+    }
+
+    result = string_view(line.s, line.l);
+
+    return true;
+}
+
+
+bool is_stream_path(path file_path){
+    return file_path == "-" or file_path.extension() == ".gz";
+}
+
+
+}
@@ -0,0 +1,70 @@
+#include "ChainElement.hpp"
+
+
+namespace liger2liger{
+
+
+ChainElement::ChainElement(
+        uint32_t contig_id,
+        uint32_t ref_start,
+        uint32_t ref_stop,
+        uint32_t query_start,
+        uint32_t query_stop,
+        uint32_t ref_length,
+        uint32_t query_length,
+        uint32_t residue_matches,
+        uint32_t alignment_length,
+        uint32_t mapping_quality,
+        bool is_reverse) :
+        contig_id(contig_id),
+        ref_start(ref_start),
+        ref_stop(ref_stop),
+        query_start(query_start),
+        query_stop(query_stop),
+        ref_length(ref_length),
+        query_length(query_length),
+        residue_matches(residue_matches),
+        alignment_length(alignment_length),
+        map_quality(mapping_quality),
+        is_reverse(is_reverse) {}
+
+
+uint32_t ChainElement::get_forward_start() const {
+    if (is_reverse) {
+        return ref_stop;
+    } else {
+        return ref_start;
+    }
+}
+
+
+uint32_t ChainElement::get_forward_stop() const {
+    if (is_reverse) {
+        return ref_start;
+    } else {
+        return ref_stop;
+    }
+}
+
+
+uint32_t ChainElement::distance_to_end_of_contig() const {
+    uint32_t distance;
+
+    if (is_reverse) {
+        distance = ref_start;
+    } else {
+        distance = ref_length - ref_stop;
+    }
+
+    return distance;
+}
+
+
+ostream& operator<<(ostream& o, const ChainElement& e) {
+    o << '(' << e.query_start << ',' << e.query_stop << ")" << (e.is_reverse ? "-" : "+") << " " << e.contig_id << " "
+      << e.ref_start << " " << e.ref_stop << " " << e.ref_length << " " << e.map_quality;
+    return o;
+}
+
+
+}
@@ -0,0 +1,270 @@
+#include "ChainPartitions.hpp"
+#include "ReadNameTable.hpp"
+
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+
+using ghc::filesystem::create_directories;
+using ghc::filesystem::remove_all;
+using std::runtime_error;
+using std::to_string;
+using std::ifstream;
+using std::ofstream;
+
+
+namespace liger2liger{
+
+
+// Each record is the length of the read name, the name, then the fields of the element in declaration order
+static const size_t name_length_bytes = sizeof(uint16_t);
+static const size_t element_bytes = 10*sizeof(uint32_t) + sizeof(uint8_t);
+
+// Size of the blocks that partition files are read in, which is much larger than any record
+static const size_t read_block_bytes = 1024*1024;
+
+
+ChainPartitions::ChainPartitions(path directory_prefix, size_t n_partitions, size_t max_buffered_bytes, uint64_t seed):
+    seed(seed),
+    max_buffered_bytes(max_buffered_bytes),
+    n_buffered_bytes(0),
+    buffers(n_partitions),
+    partition_sizes(n_partitions, 0),
+    first_read_hashes(n_partitions, 0),
+    has_several_reads(n_partitions, false)
+{
+    if (n_partitions == 0) {
+        throw runtime_error("ERROR: chain partitions need at least 1 partition");
+    }
+
+    if (directory_prefix.has_parent_path()) {
+        create_directories(directory_prefix.parent_path());
+    }
+
+    // A new directory with a unique name, so that nothing which was already there is ever written over or removed
+    string directory_template = directory_prefix.string() + "_XXXXXX";
+
+    if (mkdtemp(directory_template.data()) == nullptr) {
+        throw runtime_error("ERROR: could not create temporary directory: " + directory_template);
+    }
+
+    directory = directory_template;
+
+    for (size_t i=0; i<n_partitions; i++) {
+        partition_paths.emplace_back(directory / ("partition_" + to_string(i) + ".bin"));
+
+        ofstream file(partition_paths.back(), std::ios::binary | std::ios::trunc);
+
+        if (not file.good()) {
+            std::error_code error;
+            remove_all(directory, error);
+
+            throw runtime_error("ERROR: could not write partition file: " + partition_paths.back().string());
+        }
+    }
+}
+
+
+ChainPartitions::~ChainPartitions(){
+    std::error_code error;
+    remove_all(directory, error);
+}
+
+
+void ChainPartitions::add(string_view read_name, const ChainElement& e){
+    if (read_name.size() > UINT16_MAX) {
+        throw runtime_error("ERROR: read name is too long to spill to disk: " + string(read_name.substr(0, 100)));
+    }
+
+    auto name_hash = std::hash<string_view>()(read_name);
+    auto partition = mix_bits(name_hash ^ mix_bits(seed)) % buffers.size();
+
+    if (partition_sizes[partition] == 0 and buffers[partition].empty()) {
+        first_read_hashes[partition] = name_hash;
+    }
+    else if (name_hash != first_read_hashes[partition]) {
+        has_several_reads[partition] = true;
+    }
+
+    auto& buffer = buffers[partition];
+    auto start = buffer.size();
+
+    buffer.resize(start + name_length_bytes + read_name.size() + element_bytes);
+
+    char* c = &buffer[start];
+
+    auto write = [&](const auto& value){
+        memcpy(c, &value, sizeof(value));
+        c += sizeof(value);
+    };
+
+    write(uint16_t(read_name.size()));
+    memcpy(c, read_name.data(), read_name.size());
+    c += read_name.size();
+
+    write(e.contig_id);
+    write(e.ref_start);
+    write(e.ref_stop);
+    write(e.query_start);
+    write(e.query_stop);
+    write(e.ref_length);
+    write(e.query_length);
+    write(e.residue_matches);
+    write(e.alignment_length);
+    write(e.map_quality);
+    write(uint8_t(e.is_reverse));
+
+    n_buffered_bytes += buffer.size() - start;
+
+    if (n_buffered_bytes > max_buffered_bytes) {
+        flush();
+    }
+}
+
+
+void ChainPartitions::flush(size_t partition){
+    auto& buffer = buffers[partition];
+
+    if (buffer.empty()) {
+        return;
+    }
+
+    ofstream file(partition_paths[partition], std::ios::binary | std::ios::app);
+    file.write(buffer.data(), std::streamsize(buffer.size()));
+
+    if (not file.good()) {
+        throw runtime_error("ERROR: could not write partition file: " + partition_paths[partition].string());
+    }
+
+    partition_sizes[partition] += buffer.size();
+    n_buffered_bytes -= buffer.size();
+
+    // Release the memory, since a buffer may not be needed again for a long time
+    string().swap(buffer);
+}
+
+
+void ChainPartitions::flush(){
+    for (size_t i=0; i<buffers.size(); i++) {
+        flush(i);
+    }
+}
+
+
+void ChainPartitions::for_element_in_partition(
+        size_t partition,
+        const function<void(string_view read_name, const ChainElement& e)>& f) const{
+
+    if (not buffers[partition].empty()) {
+        throw runtime_error("ERROR: partition must be flushed before it is read");
+    }
+
+    ifstream file(partition_paths[partition], std::ios::binary);
+
+    if (not file.good()) {
+        throw runtime_error("ERROR: could not read partition file: " + partition_paths[partition].string());
+    }
+
+    vector<char> block(read_block_bytes + name_length_bytes + UINT16_MAX + element_bytes);
+    size_t begin = 0;
+    size_t end = 0;
+
+    // Move the unread tail of the block to the front and fill the rest, then check that n_bytes are available
+    auto refill = [&](size_t n_bytes){
+        std::copy(block.begin() + begin, block.begin() + end, block.begin());
+        end -= begin;
+        begin = 0;
+
+        file.read(block.data() + end, std::streamsize(block.size() - end));
+        end += size_t(file.gcount());
+
+        if (end != 0 and end < n_bytes) {
+            throw runtime_error("ERROR: truncated record in partition file: " + partition_paths[partition].string());
+        }
+    };
+
+    ChainElement e;
+
+    while (true) {
+        if (end - begin < name_length_bytes) {
+            refill(name_length_bytes);
+
+            if (end == 0) {
+                break;
+            }
+        }
+
+        uint16_t name_length;
+        memcpy(&name_length, &block[begin], name_length_bytes);
+
+        auto record_bytes = name_length_bytes + name_length + element_bytes;
+
+        if (end - begin < record_bytes) {
+            refill(record_bytes);
+        }
+
+        const char* c = &block[begin + name_length_bytes];
+        string_view read_name(c, name_length);
+        c += name_length;
+
+        auto read = [&](auto& value){
+            memcpy(&value, c, sizeof(value));
+            c += sizeof(value);
+        };
+
+        uint8_t is_reverse;
+
+        read(e.contig_id);
+        read(e.ref_start);
+        read(e.ref_stop);
+        read(e.query_start);
+        read(e.query_stop);
+        read(e.ref_length);
+        read(e.query_length);
+        read(e.residue_matches);
+        read(e.alignment_length);
+        read(e.map_quality);
+        read(is_reverse);
+
+        e.is_reverse = is_reverse;
+
+        f(read_name, e);
+
+        begin += record_bytes;
+    }
+}
+
+
+void ChainPartitions::remove(size_t partition){
+    std::error_code error;
+    ghc::filesystem::remove(partition_paths[partition], error);
+}
+
+
+uint64_t ChainPartitions::get_partition_size(size_t partition) const{
+    return partition_sizes[partition] + buffers[partition].size();
+}
+
+
+bool ChainPartitions::is_splittable(size_t partition) const{
+    return has_several_reads[partition];
+}
+
+
+uint64_t ChainPartitions::get_seed() const{
+    return seed;
+}
+
+
+path ChainPartitions::get_directory() const{
+    return directory;
+}
+
+
+size_t ChainPartitions::size() const{
+    return buffers.size();
+}
+
+
+}
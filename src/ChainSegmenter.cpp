@@ -0,0 +1,154 @@
+#include "ChainSegmenter.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+using std::reverse;
+using std::max;
+using std::min;
+
+
+namespace liger2liger{
+
+
+ChainSegmenter::ChainSegmenter(const SegmentationCosts& costs):
+    costs(costs)
+{}
+
+
+int64_t ChainSegmenter::compute_join_cost(const AlignmentChain& chain, size_t a, size_t b) const{
+    auto x = chain[a];
+    auto y = chain[b];
+
+    int64_t cost = gaps[a];
+
+    if (x.is_reverse != y.is_reverse){
+        cost += costs.strand_flip_cost;
+    }
+
+    int64_t overlap = int64_t(min(x.query_stop, y.query_stop)) - int64_t(max(x.query_start, y.query_start));
+
+    if (overlap > 0){
+        cost += overlap*costs.overlap_cost;
+    }
+
+    return cost;
+}
+
+
+/// best_costs[i] is the lowest cost of the first i elements, over every choice of start j for their last subchain:
+///
+///     best_costs[j] + split_cost + (join_costs[i-1] - join_costs[j]) + (short segment cost, if [j,i) is short)
+///
+/// with best_costs[0] = -split_cost, so that the first subchain is free. Without the short segment cost, the best j only
+/// depends on best_costs[j] - join_costs[j], so a running minimum over j finds it. A last subchain [j,i) is short when
+/// aligned_bases[i] - aligned_bases[j] < min_segment_bases, so the starts that make it long enough are a prefix of j,
+/// which only grows with i. Those go into the running minimum as it grows, and the short starts that remain are kept in
+/// a queue ordered by cost, from which any start that becomes long enough is dropped from the front, so each start is
+/// added and removed once.
+int64_t ChainSegmenter::split(const AlignmentChain& chain, vector<pair<size_t, size_t> >& subchain_bounds){
+    size_t n = chain.size();
+
+    subchain_bounds.clear();
+
+    // A single alignment can't be split, which is the case for most reads
+    if (n < 2){
+        subchain_bounds.emplace_back(0, n);
+
+        if (n == 0){
+            return 0;
+        }
+
+        auto e = chain[0];
+        uint64_t bases = (e.query_stop > e.query_start) ? e.query_stop - e.query_start : 0;
+
+        return (bases < costs.min_segment_bases) ? costs.short_segment_cost : 0;
+    }
+
+    chain.compute_gaps(gaps, costs.contig_jump_cost);
+
+    join_costs.assign(n, 0);
+    aligned_bases.assign(n + 1, 0);
+
+    for (size_t i=0; i<n; i++){
+        auto e = chain[i];
+        aligned_bases[i+1] = aligned_bases[i] + ((e.query_stop > e.query_start) ? e.query_stop - e.query_start : 0);
+
+        if (i + 1 < n){
+            join_costs[i+1] = join_costs[i] + compute_join_cost(chain, i, i + 1);
+        }
+    }
+
+    best_costs.assign(n + 1, 0);
+    n_subchains.assign(n + 1, 0);
+    last_starts.assign(n + 1, 0);
+    short_starts.clear();
+
+    best_costs[0] = -int64_t(costs.split_cost);
+
+    // Ordering of candidate starts, by cost and then by number of subchains. Both only differ between starts by
+    // best_costs[j] - join_costs[j] and n_subchains[j], and by the short segment cost, which is the same within a queue.
+    auto key = [&](uint32_t j){
+        return std::make_tuple(best_costs[j] - join_costs[j], n_subchains[j]);
+    };
+
+    // Last start, and best start so far, for which the last subchain is long enough. -1 if there is none.
+    int64_t long_end = -1;
+    int64_t best_long_start = -1;
+
+    for (size_t i=1; i<=n; i++){
+        uint32_t j = i - 1;
+
+        while (not short_starts.empty() and key(short_starts.back()) >= key(j)){
+            short_starts.pop_back();
+        }
+
+        short_starts.emplace_back(j);
+
+        while (long_end + 1 < int64_t(i) and aligned_bases[i] - aligned_bases[long_end + 1] >= costs.min_segment_bases){
+            long_end++;
+
+            if (best_long_start < 0 or key(uint32_t(long_end)) < key(uint32_t(best_long_start))){
+                best_long_start = long_end;
+            }
+        }
+
+        while (not short_starts.empty() and int64_t(short_starts.front()) <= long_end){
+            short_starts.pop_front();
+        }
+
+        int64_t cost_of_rest = int64_t(costs.split_cost) + join_costs[i-1];
+        bool has_candidate = false;
+
+        auto consider = [&](uint32_t start, int64_t extra_cost){
+            int64_t cost = best_costs[start] - join_costs[start] + cost_of_rest + extra_cost;
+            uint32_t count = n_subchains[start] + 1;
+
+            if (not has_candidate or std::make_tuple(cost, count) < std::make_tuple(best_costs[i], n_subchains[i])){
+                best_costs[i] = cost;
+                n_subchains[i] = count;
+                last_starts[i] = start;
+                has_candidate = true;
+            }
+        };
+
+        if (best_long_start >= 0){
+            consider(uint32_t(best_long_start), 0);
+        }
+
+        if (not short_starts.empty()){
+            consider(short_starts.front(), costs.short_segment_cost);
+        }
+    }
+
+    for (size_t i=n; i > 0; i=last_starts[i]){
+        subchain_bounds.emplace_back(last_starts[i], i);
+    }
+
+    reverse(subchain_bounds.begin(), subchain_bounds.end());
+
+    return best_costs[n];
+}
+
+
+}
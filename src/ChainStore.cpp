@@ -0,0 +1,211 @@
+#include "ChainStore.hpp"
+
+#include <type_traits>
+#include <stdexcept>
+#include <string>
+
+using std::runtime_error;
+
+
+namespace liger2liger{
+
+
+ChainStore::ChainStore():
+    is_grouped(true)
+{}
+
+
+/// Call f on every field column. The read id column is not included, because it is handled separately by each caller.
+template<class T> void ChainStore::for_each_column(const T& f){
+    f(contig_ids);
+    f(ref_starts);
+    f(ref_stops);
+    f(query_starts);
+    f(query_stops);
+    f(ref_lengths);
+    f(query_lengths);
+    f(residue_matches);
+    f(alignment_lengths);
+    f(map_qualities);
+    f(is_reverse);
+}
+
+
+void ChainStore::add(uint32_t read_id, const ChainElement& e){
+    read_ids.emplace_back(read_id);
+    contig_ids.emplace_back(e.contig_id);
+    ref_starts.emplace_back(e.ref_start);
+    ref_stops.emplace_back(e.ref_stop);
+    query_starts.emplace_back(e.query_start);
+    query_stops.emplace_back(e.query_stop);
+    ref_lengths.emplace_back(e.ref_length);
+    query_lengths.emplace_back(e.query_length);
+    residue_matches.emplace_back(e.residue_matches);
+    alignment_lengths.emplace_back(e.alignment_length);
+    map_qualities.emplace_back(e.map_quality);
+    is_reverse.emplace_back(e.is_reverse);
+
+    is_grouped = false;
+}
+
+
+void ChainStore::append(
+        const ChainStore& other,
+        const vector<uint32_t>& read_id_map,
+        const vector<uint32_t>& contig_id_map){
+
+    for (auto id: other.read_ids){
+        read_ids.emplace_back(read_id_map[id]);
+    }
+
+    for (auto id: other.contig_ids){
+        contig_ids.emplace_back(contig_id_map[id]);
+    }
+
+    auto append_column = [](auto& column, const auto& other_column){
+        column.insert(column.end(), other_column.begin(), other_column.end());
+    };
+
+    append_column(ref_starts, other.ref_starts);
+    append_column(ref_stops, other.ref_stops);
+    append_column(query_starts, other.query_starts);
+    append_column(query_stops, other.query_stops);
+    append_column(ref_lengths, other.ref_lengths);
+    append_column(query_lengths, other.query_lengths);
+    append_column(residue_matches, other.residue_matches);
+    append_column(alignment_lengths, other.alignment_lengths);
+    append_column(map_qualities, other.map_qualities);
+    append_column(is_reverse, other.is_reverse);
+
+    is_grouped = other.empty() and is_grouped;
+}
+
+
+void ChainStore::group_by_read(size_t n_reads){
+    if (is_grouped and read_offsets.size() == n_reads + 1){
+        return;
+    }
+
+    read_offsets.assign(n_reads + 1, 0);
+
+    for (auto id: read_ids){
+        if (id >= n_reads){
+            throw runtime_error("ERROR: chain element has read id " + std::to_string(id) + " but there are only " +
+                                std::to_string(n_reads) + " reads");
+        }
+
+        read_offsets[id + 1]++;
+    }
+
+    for (size_t i=1; i<read_offsets.size(); i++){
+        read_offsets[i] += read_offsets[i - 1];
+    }
+
+    // Destination of each element, filling each read's range in order of addition
+    vector<size_t> destinations(read_ids.size());
+    vector<size_t> next_offsets(read_offsets.begin(), read_offsets.end() - 1);
+
+    for (size_t i=0; i<read_ids.size(); i++){
+        destinations[i] = next_offsets[read_ids[i]]++;
+    }
+
+    auto scatter = [&](auto& column){
+        std::remove_reference_t<decltype(column)> result(column.size());
+
+        for (size_t i=0; i<column.size(); i++){
+            result[destinations[i]] = column[i];
+        }
+
+        column.swap(result);
+    };
+
+    for_each_column(scatter);
+    scatter(read_ids);
+
+    is_grouped = true;
+}
+
+
+void ChainStore::permute(size_t offset, const vector<uint32_t>& order){
+    scratch.resize(order.size());
+
+    for_each_column([&](auto& column){
+        for (size_t i=0; i<order.size(); i++){
+            scratch[i] = column[offset + order[i]];
+        }
+
+        for (size_t i=0; i<order.size(); i++){
+            column[offset + i] = scratch[i];
+        }
+    });
+}
+
+
+size_t ChainStore::get_offset(uint32_t read_id) const{
+    if (not is_grouped){
+        throw runtime_error("ERROR: chain elements must be grouped by read before reading a chain");
+    }
+
+    return read_offsets.at(read_id);
+}
+
+
+size_t ChainStore::get_length(uint32_t read_id) const{
+    return get_offset(read_id + 1) - get_offset(read_id);
+}
+
+
+ChainElement ChainStore::get_element(size_t index) const{
+    return {
+        contig_ids[index],
+        ref_starts[index],
+        ref_stops[index],
+        query_starts[index],
+        query_stops[index],
+        ref_lengths[index],
+        query_lengths[index],
+        residue_matches[index],
+        alignment_lengths[index],
+        map_qualities[index],
+        bool(is_reverse[index])
+    };
+}
+
+
+uint32_t ChainStore::get_forward_start(size_t index) const{
+    return is_reverse[index] ? ref_stops[index] : ref_starts[index];
+}
+
+
+uint32_t ChainStore::get_forward_stop(size_t index) const{
+    return is_reverse[index] ? ref_starts[index] : ref_stops[index];
+}
+
+
+uint32_t ChainStore::distance_to_end_of_contig(size_t index) const{
+    return is_reverse[index] ? ref_starts[index] : ref_lengths[index] - ref_stops[index];
+}
+
+
+size_t ChainStore::size() const{
+    return read_ids.size();
+}
+
+
+bool ChainStore::empty() const{
+    return read_ids.empty();
+}
+
+
+void ChainStore::clear(){
+    for_each_column([](auto& column){
+        column.clear();
+    });
+
+    read_ids.clear();
+    read_offsets.clear();
+    is_grouped = true;
+}
+
+
+}
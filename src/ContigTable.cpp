@@ -0,0 +1,67 @@
+#include "ContigTable.hpp"
+
+#include <stdexcept>
+
+using std::runtime_error;
+using std::to_string;
+
+
+namespace liger2liger{
+
+
+uint32_t ContigTable::get_id(string_view name, uint32_t length){
+    auto result = ids.find(name);
+
+    if (result != ids.end()){
+        if (lengths[result->second] != length){
+            throw runtime_error("ERROR: contig " + string(name) + " has conflicting lengths: " +
+                                to_string(lengths[result->second]) + " and " + to_string(length));
+        }
+
+        return result->second;
+    }
+
+    uint32_t id = names.size();
+
+    names.emplace_back(name);
+    lengths.emplace_back(length);
+    ids.emplace(names.back(), id);
+
+    return id;
+}
+
+
+uint32_t ContigTable::find_id(string_view name) const{
+    auto result = ids.find(name);
+
+    if (result == ids.end()){
+        throw runtime_error("ERROR: contig not found in contig table: " + string(name));
+    }
+
+    return result->second;
+}
+
+
+const string& ContigTable::get_name(uint32_t id) const{
+    return names.at(id);
+}
+
+
+uint32_t ContigTable::get_length(uint32_t id) const{
+    return lengths.at(id);
+}
+
+
+size_t ContigTable::size() const{
+    return names.size();
+}
+
+
+void ContigTable::clear(){
+    ids.clear();
+    lengths.clear();
+    names.clear();
+}
+
+
+}
@@ -0,0 +1,156 @@
+#include "DelimiterScanner.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIGER2LIGER_X86
+#include <immintrin.h>
+#endif
+
+#include <stdexcept>
+
+using std::runtime_error;
+
+
+namespace liger2liger{
+
+
+using FindFunction = const char* (*)(const char* begin, const char* end, char a, char b);
+
+
+const char* find_delimiter_scalar(const char* begin, const char* end, char a, char b){
+    for (const char* p = begin; p < end; p++){
+        if (*p == a or *p == b){
+            return p;
+        }
+    }
+
+    return end;
+}
+
+
+#ifdef LIGER2LIGER_X86
+
+const char* find_delimiter_sse2(const char* begin, const char* end, char a, char b){
+    const __m128i a_vector = _mm_set1_epi8(a);
+    const __m128i b_vector = _mm_set1_epi8(b);
+
+    const char* p = begin;
+
+    for (; end - p >= 16; p += 16){
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(chunk, a_vector), _mm_cmpeq_epi8(chunk, b_vector));
+        int mask = _mm_movemask_epi8(matches);
+
+        if (mask != 0){
+            return p + __builtin_ctz(mask);
+        }
+    }
+
+    return find_delimiter_scalar(p, end, a, b);
+}
+
+
+__attribute__((target("avx2")))
+const char* find_delimiter_avx2(const char* begin, const char* end, char a, char b){
+    const __m256i a_vector = _mm256_set1_epi8(a);
+    const __m256i b_vector = _mm256_set1_epi8(b);
+
+    const char* p = begin;
+
+    for (; end - p >= 32; p += 32){
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, a_vector), _mm256_cmpeq_epi8(chunk, b_vector));
+        uint32_t mask = _mm256_movemask_epi8(matches);
+
+        if (mask != 0){
+            return p + __builtin_ctz(mask);
+        }
+    }
+
+    // PAF fields are short, so the remainder is usually worth one more 16 byte step before going scalar
+    return find_delimiter_sse2(p, end, a, b);
+}
+
+#else
+
+const char* find_delimiter_sse2(const char* begin, const char* end, char a, char b){
+    throw runtime_error("ERROR: SSE2 delimiter scanning is not available on this architecture");
+}
+
+
+const char* find_delimiter_avx2(const char* begin, const char* end, char a, char b){
+    throw runtime_error("ERROR: AVX2 delimiter scanning is not available on this architecture");
+}
+
+#endif
+
+
+SimdLevel get_supported_simd_level(){
+#ifdef LIGER2LIGER_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")){
+        return SimdLevel::avx2;
+    }
+    if (__builtin_cpu_supports("sse2")){
+        return SimdLevel::sse2;
+    }
+#endif
+
+    return SimdLevel::scalar;
+}
+
+
+FindFunction get_find_function(SimdLevel level){
+    switch (level){
+        case SimdLevel::avx2:
+            return find_delimiter_avx2;
+        case SimdLevel::sse2:
+            return find_delimiter_sse2;
+        default:
+            return find_delimiter_scalar;
+    }
+}
+
+
+static SimdLevel simd_level = get_supported_simd_level();
+static FindFunction find_function = get_find_function(simd_level);
+
+
+void set_simd_level(SimdLevel level){
+    if (level > get_supported_simd_level()){
+        throw runtime_error("ERROR: CPU does not support requested SIMD level: " + to_string(level));
+    }
+
+    simd_level = level;
+    find_function = get_find_function(level);
+}
+
+
+SimdLevel get_simd_level(){
+    return simd_level;
+}
+
+
+const char* find_delimiter(const char* begin, const char* end, char a, char b){
+    return find_function(begin, end, a, b);
+}
+
+
+const char* find_delimiter(const char* begin, const char* end, char a){
+    return find_function(begin, end, a, a);
+}
+
+
+string to_string(SimdLevel level){
+    switch (level){
+        case SimdLevel::avx2:
+            return "avx2";
+        case SimdLevel::sse2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
+
+
+}
@@ -0,0 +1,130 @@
+#include "GapKernel.hpp"
+#include "DelimiterScanner.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIGER2LIGER_X86
+#include <immintrin.h>
+#endif
+
+#include <stdexcept>
+#include <cstdlib>
+
+using std::runtime_error;
+
+
+namespace liger2liger{
+
+
+/// Same arithmetic as AlignmentChain::compute_distance, read directly from the columns of the store, with the strand of
+/// each element selecting its coordinates rather than branching on it
+inline uint32_t compute_gap(const ChainStore& store, size_t a, size_t b, uint32_t contig_penalty){
+    bool a_reverse = store.is_reverse[a];
+    bool b_reverse = store.is_reverse[b];
+
+    uint32_t a_start = a_reverse ? store.ref_stops[a] : store.ref_starts[a];
+    uint32_t a_stop = a_reverse ? store.ref_starts[a] : store.ref_stops[a];
+    uint32_t b_start = b_reverse ? store.ref_stops[b] : store.ref_starts[b];
+    uint32_t b_stop = b_reverse ? store.ref_starts[b] : store.ref_stops[b];
+
+    uint32_t a_to_end = a_reverse ? store.ref_starts[a] : store.ref_lengths[a] - store.ref_stops[a];
+    uint32_t b_to_end = b_reverse ? store.ref_starts[b] : store.ref_lengths[b] - store.ref_stops[b];
+
+    bool is_overlapping = (a_stop > b_start and a_start < b_stop) or (b_stop > a_start and b_start < a_stop);
+
+    uint32_t same_contig_distance = is_overlapping ? 0 : uint32_t(abs(int32_t(a_stop - b_start)));
+    uint32_t contig_jump_distance = a_to_end + b_to_end + contig_penalty;
+
+    return (store.contig_ids[a] == store.contig_ids[b]) ? same_contig_distance : contig_jump_distance;
+}
+
+
+void compute_gaps_scalar(const ChainStore& store, size_t begin, size_t end, uint32_t contig_penalty, uint32_t* gaps){
+    for (size_t i=begin; i + 1 < end; i++){
+        gaps[i - begin] = compute_gap(store, i, i + 1, contig_penalty);
+    }
+}
+
+
+#ifdef LIGER2LIGER_X86
+
+/// Unsigned 32 bit comparison, which AVX2 only has for signed lanes, so both sides are offset by the sign bit
+__attribute__((target("avx2")))
+inline __m256i greater_than_unsigned(__m256i a, __m256i b){
+    const __m256i sign = _mm256_set1_epi32(int32_t(0x80000000));
+    return _mm256_cmpgt_epi32(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+}
+
+
+__attribute__((target("avx2")))
+inline __m256i load_column(const vector<uint32_t>& column, size_t i){
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column.data() + i));
+}
+
+
+/// Strand flags are bytes, which are widened to a full lane mask
+__attribute__((target("avx2")))
+inline __m256i load_reverse(const vector<uint8_t>& is_reverse, size_t i){
+    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(is_reverse.data() + i));
+    return _mm256_cmpgt_epi32(_mm256_cvtepu8_epi32(bytes), _mm256_setzero_si256());
+}
+
+
+/// Eight neighbouring pairs per iteration, in which element i of each column is loaded alongside element i + 1. Every
+/// branch of compute_gap becomes a blend, so each lane costs the same whatever its strands and contigs.
+__attribute__((target("avx2")))
+void compute_gaps_avx2(const ChainStore& store, size_t begin, size_t end, uint32_t contig_penalty, uint32_t* gaps){
+    const __m256i penalty = _mm256_set1_epi32(int32_t(contig_penalty));
+    size_t i = begin;
+
+    for (; i + 8 < end; i += 8){
+        __m256i a_reverse = load_reverse(store.is_reverse, i);
+        __m256i b_reverse = load_reverse(store.is_reverse, i + 1);
+
+        __m256i a_ref_start = load_column(store.ref_starts, i);
+        __m256i a_ref_stop = load_column(store.ref_stops, i);
+        __m256i b_ref_start = load_column(store.ref_starts, i + 1);
+        __m256i b_ref_stop = load_column(store.ref_stops, i + 1);
+
+        __m256i a_start = _mm256_blendv_epi8(a_ref_start, a_ref_stop, a_reverse);
+        __m256i a_stop = _mm256_blendv_epi8(a_ref_stop, a_ref_start, a_reverse);
+        __m256i b_start = _mm256_blendv_epi8(b_ref_start, b_ref_stop, b_reverse);
+        __m256i b_stop = _mm256_blendv_epi8(b_ref_stop, b_ref_start, b_reverse);
+
+        __m256i a_to_end = _mm256_blendv_epi8(_mm256_sub_epi32(load_column(store.ref_lengths, i), a_ref_stop), a_ref_start, a_reverse);
+        __m256i b_to_end = _mm256_blendv_epi8(_mm256_sub_epi32(load_column(store.ref_lengths, i + 1), b_ref_stop), b_ref_start, b_reverse);
+
+        // Both halves of the overlap test in compute_gap are the same two comparisons, so one is enough
+        __m256i is_overlapping = _mm256_and_si256(greater_than_unsigned(a_stop, b_start), greater_than_unsigned(b_stop, a_start));
+
+        __m256i same_contig_distance = _mm256_andnot_si256(is_overlapping, _mm256_abs_epi32(_mm256_sub_epi32(a_stop, b_start)));
+        __m256i contig_jump_distance = _mm256_add_epi32(_mm256_add_epi32(a_to_end, b_to_end), penalty);
+
+        __m256i is_same_contig = _mm256_cmpeq_epi32(load_column(store.contig_ids, i), load_column(store.contig_ids, i + 1));
+        __m256i distance = _mm256_blendv_epi8(contig_jump_distance, same_contig_distance, is_same_contig);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gaps + (i - begin)), distance);
+    }
+
+    compute_gaps_scalar(store, i, end, contig_penalty, gaps + (i - begin));
+}
+
+#else
+
+void compute_gaps_avx2(const ChainStore& store, size_t begin, size_t end, uint32_t contig_penalty, uint32_t* gaps){
+    throw runtime_error("ERROR: AVX2 gap computation is not available on this architecture");
+}
+
+#endif
+
+
+void compute_gaps(const ChainStore& store, size_t begin, size_t end, uint32_t contig_penalty, uint32_t* gaps){
+    if (get_simd_level() == SimdLevel::avx2){
+        compute_gaps_avx2(store, begin, end, contig_penalty, gaps);
+    }
+    else{
+        compute_gaps_scalar(store, begin, end, contig_penalty, gaps);
+    }
+}
+
+
+}
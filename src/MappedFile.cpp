@@ -0,0 +1,83 @@
+#include "MappedFile.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+using std::runtime_error;
+
+
+namespace liger2liger{
+
+
+MappedFile::MappedFile(path file_path):
+    file_path(file_path),
+    file_descriptor(-1),
+    data(nullptr),
+    length(0)
+{
+    if ((file_descriptor = open(file_path.string().c_str(), O_RDONLY)) < 0){
+        throw runtime_error("ERROR: could not open input file: " + file_path.string());
+    }
+
+    struct stat file_stats;
+
+    if (fstat(file_descriptor, &file_stats) < 0 or not S_ISREG(file_stats.st_mode)){
+        close(file_descriptor);
+        throw runtime_error("ERROR: cannot memory map file that is not a regular file: " + file_path.string());
+    }
+
+    length = file_stats.st_size;
+
+    // mmap does not accept zero length mappings, so an empty file is just an empty view
+    if (length > 0){
+        void* result = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+
+        if (result == MAP_FAILED){
+            close(file_descriptor);
+            throw runtime_error("ERROR: could not memory map file: " + file_path.string());
+        }
+
+        // Parsing is a single forward pass, so let the kernel read ahead aggressively
+        madvise(result, length, MADV_SEQUENTIAL);
+
+        data = static_cast<const char*>(result);
+    }
+}
+
+
+MappedFile::~MappedFile(){
+    if (data != nullptr){
+        munmap(const_cast<char*>(data), length);
+    }
+
+    if (file_descriptor > -1){
+        close(file_descriptor);
+    }
+}
+
+
+const char* MappedFile::begin() const{
+    return data;
+}
+
+
+const char* MappedFile::end() const{
+    return data + length;
+}
+
+
+size_t MappedFile::size() const{
+    return length;
+}
+
+
+string_view MappedFile::view() const{
+    return {data, length};
+}
+
+
+}
@@ -0,0 +1,94 @@
+#include "PafRecord.hpp"
+#include "DelimiterScanner.hpp"
+
+#include <stdexcept>
+#include <charconv>
+#include <string>
+
+using std::runtime_error;
+using std::from_chars;
+using std::errc;
+using std::string;
+
+
+namespace liger2liger {
+
+
+static const size_t n_paf_fields = 12;
+
+
+uint32_t parse_paf_integer(string_view token){
+    uint32_t value = 0;
+
+    auto result = from_chars(token.data(), token.data() + token.size(), value);
+
+    if (result.ec != errc() or result.ptr != token.data() + token.size()){
+        throw runtime_error("ERROR: could not parse integer in PAF column: " + string(token));
+    }
+
+    return value;
+}
+
+
+bool parse_paf_strand(string_view token){
+    bool is_reverse;
+
+    if (token == "-") {
+        is_reverse = true;
+    } else if (token == "+") {
+        is_reverse = false;
+    } else {
+        throw runtime_error("ERROR: uninterpretable directional symbol is not '-' or '+': " + string(token));
+    }
+
+    return is_reverse;
+}
+
+
+bool parse_paf_line(string_view line, PafRecord& record){
+    string_view fields[n_paf_fields];
+
+    const char* cursor = line.data();
+    const char* end = line.data() + line.size();
+
+    size_t n_fields = 0;
+
+    while (n_fields < n_paf_fields) {
+        auto tab = find_delimiter(cursor, end, '\t');
+
+        fields[n_fields++] = string_view(cursor, tab - cursor);
+
+        cursor = tab;
+
+        if (tab == end){
+            break;
+        }
+
+        cursor++;
+    }
+
+    if (n_fields < n_paf_fields){
+        return false;
+    }
+
+    record.query_name = fields[0];
+    record.query_length = parse_paf_integer(fields[1]);
+    record.query_start = parse_paf_integer(fields[2]);
+    record.query_stop = parse_paf_integer(fields[3]);
+    record.is_reverse = parse_paf_strand(fields[4]);
+    record.ref_name = fields[5];
+    record.ref_length = parse_paf_integer(fields[6]);
+    record.ref_start = parse_paf_integer(fields[7]);
+    record.ref_stop = parse_paf_integer(fields[8]);
+    record.residue_matches = parse_paf_integer(fields[9]);
+    record.alignment_length = parse_paf_integer(fields[10]);
+    record.map_quality = parse_paf_integer(fields[11]);
+
+    // Everything remaining is optional SAM-style tags
+    record.tags.index(string_view(cursor, end - cursor));
+
+    return true;
+}
+
+
+}
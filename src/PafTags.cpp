@@ -0,0 +1,128 @@
+#include "PafTags.hpp"
+#include "DelimiterScanner.hpp"
+
+#include <stdexcept>
+#include <charconv>
+#include <string>
+
+using std::runtime_error;
+using std::from_chars;
+using std::string;
+using std::errc;
+
+
+namespace liger2liger {
+
+
+// Two character name and SAM type code of each indexed tag, in the order of PafTags::Key
+static const array<string_view, PafTags::n_keys> tag_prefixes = {
+        "tp:A:",
+        "cm:i:",
+        "s1:i:",
+        "dv:f:",
+        "NM:i:",
+        "SA:Z:"
+};
+
+
+void PafTags::index(string_view fields){
+    values.fill(string_view());
+
+    const char* cursor = fields.data();
+    const char* end = fields.data() + fields.size();
+
+    while (cursor < end){
+        auto tab = find_delimiter(cursor, end, '\t');
+
+        string_view field(cursor, tab - cursor);
+
+        // Every SAM tag is "XX:T:" followed by the value, so the key and type can be matched directly
+        if (field.size() >= 5){
+            for (size_t k=0; k<n_keys; k++){
+                if (field.compare(0, 5, tag_prefixes[k]) == 0){
+                    values[k] = field.substr(5);
+                    break;
+                }
+            }
+        }
+
+        cursor = tab + 1;
+    }
+}
+
+
+bool PafTags::has(Key key) const{
+    return values[key].data() != nullptr;
+}
+
+
+bool PafTags::get_char(Key key, char& value) const{
+    if (not has(key)){
+        return false;
+    }
+
+    if (values[key].size() != 1){
+        throw runtime_error("ERROR: PAF tag is not a single character: " + string(tag_prefixes[key]) + string(values[key]));
+    }
+
+    value = values[key][0];
+
+    return true;
+}
+
+
+bool PafTags::get_int(Key key, int64_t& value) const{
+    if (not has(key)){
+        return false;
+    }
+
+    auto& v = values[key];
+    auto result = from_chars(v.data(), v.data() + v.size(), value);
+
+    if (result.ec != errc() or result.ptr != v.data() + v.size()){
+        throw runtime_error("ERROR: could not parse integer PAF tag: " + string(tag_prefixes[key]) + string(v));
+    }
+
+    return true;
+}
+
+
+bool PafTags::get_float(Key key, float& value) const{
+    if (not has(key)){
+        return false;
+    }
+
+    auto& v = values[key];
+    auto result = from_chars(v.data(), v.data() + v.size(), value);
+
+    if (result.ec != errc() or result.ptr != v.data() + v.size()){
+        throw runtime_error("ERROR: could not parse float PAF tag: " + string(tag_prefixes[key]) + string(v));
+    }
+
+    return true;
+}
+
+
+bool PafTags::get_string(Key key, string_view& value) const{
+    if (not has(key)){
+        return false;
+    }
+
+    value = values[key];
+
+    return true;
+}
+
+
+bool PafTags::is_primary() const{
+    char t;
+
+    if (get_char(type, t)){
+        return t != 'S';
+    }
+
+    return true;
+}
+
+
+}
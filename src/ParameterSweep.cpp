@@ -0,0 +1,288 @@
+#include "ParameterSweep.hpp"
+
+#include <functional>
+#include <stdexcept>
+#include <exception>
+#include <algorithm>
+#include <thread>
+
+using std::runtime_error;
+using std::exception_ptr;
+using std::greater;
+using std::thread;
+using std::sort;
+using std::min;
+using std::max;
+
+
+namespace liger2liger{
+
+
+void SweepResult::merge(SweepResult& other){
+    n_chimers += other.n_chimers;
+    n_non_chimers += other.n_non_chimers;
+    n_subchains += other.n_subchains;
+
+    chimer_lengths.insert(chimer_lengths.end(), other.chimer_lengths.begin(), other.chimer_lengths.end());
+    non_chimer_lengths.insert(non_chimer_lengths.end(), other.non_chimer_lengths.begin(), other.non_chimer_lengths.end());
+    subchain_lengths.insert(subchain_lengths.end(), other.subchain_lengths.begin(), other.subchain_lengths.end());
+
+    other = {};
+}
+
+
+uint32_t get_n50(vector<uint32_t>& lengths){
+    sort(lengths.begin(), lengths.end(), greater<uint32_t>());
+
+    uint64_t total = 0;
+
+    for (auto l: lengths){
+        total += l;
+    }
+
+    uint64_t cumulative = 0;
+
+    for (auto l: lengths){
+        cumulative += l;
+
+        if (cumulative*2 >= total){
+            return l;
+        }
+    }
+
+    return 0;
+}
+
+
+/// The elements of a sorted chain that pass a map quality, and the distance between each neighbouring pair of them
+/// without any gap penalty. Reused between chains by the thread that owns it.
+class ChainGaps {
+public:
+    vector<uint32_t> indexes;
+    vector<uint32_t> query_starts;
+    vector<uint32_t> query_stops;
+    vector<uint32_t> distances;
+    vector<uint8_t> is_contig_jump;
+    uint32_t query_length;
+
+    void compute(const AlignmentChain& chain, uint32_t min_quality);
+};
+
+
+void ChainGaps::compute(const AlignmentChain& chain, uint32_t min_quality){
+    indexes.clear();
+    query_starts.clear();
+    query_stops.clear();
+    distances.clear();
+    is_contig_jump.clear();
+
+    uint32_t prev_contig_id = 0;
+
+    for (size_t i=0; i<chain.size(); i++){
+        auto e = chain[i];
+
+        if (e.map_quality <= min_quality){
+            continue;
+        }
+
+        if (not indexes.empty()){
+            is_contig_jump.emplace_back(e.contig_id != prev_contig_id);
+        }
+
+        indexes.emplace_back(i);
+        query_starts.emplace_back(e.query_start);
+        query_stops.emplace_back(e.query_stop);
+        query_length = e.query_length;
+
+        prev_contig_id = e.contig_id;
+    }
+
+    // Usually no element is filtered, and then the pairs are neighbours in the store, which the gap kernel does at once
+    if (indexes.size() == chain.size()){
+        chain.compute_gaps(distances, 0);
+        return;
+    }
+
+    for (size_t i=1; i<indexes.size(); i++){
+        distances.emplace_back(chain.compute_distance(indexes[i-1], indexes[i], 0));
+    }
+}
+
+
+ParameterSweep::ParameterSweep(
+        const vector<uint32_t>& min_qualities,
+        const vector<uint32_t>& gap_penalties,
+        const vector<uint32_t>& max_gaps):
+    min_qualities(min_qualities),
+    gap_penalties(gap_penalties),
+    max_gaps(max_gaps)
+{
+    if (min_qualities.empty() or gap_penalties.empty() or max_gaps.empty()){
+        throw runtime_error("ERROR: parameter sweep needs at least one value of each parameter");
+    }
+
+    for (auto q: min_qualities){
+        if (q < AlignmentChains::min_quality){
+            throw runtime_error("ERROR: cannot sweep map quality " + std::to_string(q) + ", since alignments with map "
+                                "quality of " + std::to_string(AlignmentChains::min_quality) + " or less are not loaded");
+        }
+    }
+
+    results.resize(size());
+}
+
+
+size_t ParameterSweep::size() const{
+    return min_qualities.size()*gap_penalties.size()*max_gaps.size();
+}
+
+
+size_t ParameterSweep::get_index(size_t q, size_t p, size_t g) const{
+    return (q*gap_penalties.size() + p)*max_gaps.size() + g;
+}
+
+
+void ParameterSweep::evaluate(const AlignmentChain& chain, ChainGaps& gaps, vector<SweepResult>& thread_results) const{
+    for (size_t q=0; q<min_qualities.size(); q++){
+        gaps.compute(chain, min_qualities[q]);
+
+        // Reads that have no alignments left at this quality are not counted, as they would not be loaded
+        if (gaps.query_starts.empty()){
+            continue;
+        }
+
+        for (size_t p=0; p<gap_penalties.size(); p++){
+            for (size_t g=0; g<max_gaps.size(); g++){
+                auto& result = thread_results[get_index(q, p, g)];
+
+                size_t n_breaks = 0;
+
+                for (size_t i=0; i<gaps.distances.size(); i++){
+                    uint32_t distance = gaps.distances[i] + (gaps.is_contig_jump[i] ? gap_penalties[p] : 0);
+                    n_breaks += (distance > max_gaps[g]);
+                }
+
+                if (n_breaks == 0){
+                    result.n_non_chimers++;
+                    result.non_chimer_lengths.emplace_back(gaps.query_length);
+                    continue;
+                }
+
+                result.n_chimers++;
+                result.n_subchains += n_breaks + 1;
+                result.chimer_lengths.emplace_back(gaps.query_length);
+
+                // Walk the subchains again, now that this read is known to be chimeric, to measure each one
+                uint32_t start = gaps.query_starts[0];
+                uint32_t stop = gaps.query_stops[0];
+
+                for (size_t i=0; i<gaps.distances.size(); i++){
+                    uint32_t distance = gaps.distances[i] + (gaps.is_contig_jump[i] ? gap_penalties[p] : 0);
+
+                    if (distance > max_gaps[g]){
+                        result.subchain_lengths.emplace_back(stop - start);
+                        start = gaps.query_starts[i+1];
+                        stop = gaps.query_stops[i+1];
+                    }
+                    else{
+                        start = min(start, gaps.query_starts[i+1]);
+                        stop = max(stop, gaps.query_stops[i+1]);
+                    }
+                }
+
+                result.subchain_lengths.emplace_back(stop - start);
+            }
+        }
+    }
+}
+
+
+void ParameterSweep::evaluate(AlignmentChains& chains, size_t n_threads){
+    if (n_threads == 0){
+        throw runtime_error("ERROR: cannot run parameter sweep with 0 threads");
+    }
+
+    // Sorting permutes through a buffer that the store shares between chains, so it is done before the reads are
+    // divided between threads, after which chains are only read
+    chains.for_each_chain([&](string_view, AlignmentChain& chain){
+        chain.sort_chain();
+    }, ReadOrder::first_seen);
+
+    size_t n_reads = chains.read_names.size();
+
+    vector<vector<SweepResult> > thread_results(n_threads, vector<SweepResult>(size()));
+    vector<exception_ptr> exceptions(n_threads);
+    vector<thread> threads;
+
+    for (size_t i=0; i<n_threads; i++){
+        threads.emplace_back([&, i](){
+            try {
+                ChainGaps gaps;
+
+                for (size_t id = n_reads*i/n_threads; id < n_reads*(i + 1)/n_threads; id++){
+                    evaluate(chains.get_chain(uint32_t(id)), gaps, thread_results[i]);
+                }
+            }
+            catch (...) {
+                exceptions[i] = std::current_exception();
+            }
+        });
+    }
+
+    for (auto& t: threads){
+        t.join();
+    }
+
+    for (auto& e: exceptions){
+        if (e){
+            std::rethrow_exception(e);
+        }
+    }
+
+    results.assign(size(), {});
+
+    for (auto& thread_result: thread_results){
+        for (size_t i=0; i<size(); i++){
+            results[i].merge(thread_result[i]);
+        }
+    }
+}
+
+
+void ParameterSweep::write_table(ostream& file){
+    file << "min_quality" << '\t'
+         << "gap_penalty" << '\t'
+         << "max_gap" << '\t'
+         << "n_chimers" << '\t'
+         << "n_non_chimers" << '\t'
+         << "chimer_fraction" << '\t'
+         << "n_subchains" << '\t'
+         << "non_chimer_n50" << '\t'
+         << "chimer_n50" << '\t'
+         << "subchain_n50" << '\n';
+
+    for (size_t q=0; q<min_qualities.size(); q++){
+        for (size_t p=0; p<gap_penalties.size(); p++){
+            for (size_t g=0; g<max_gaps.size(); g++){
+                auto& result = results[get_index(q, p, g)];
+
+                auto n_reads = result.n_chimers + result.n_non_chimers;
+                double chimer_fraction = (n_reads > 0) ? double(result.n_chimers)/double(n_reads) : 0;
+
+                file << min_qualities[q] << '\t'
+                     << gap_penalties[p] << '\t'
+                     << max_gaps[g] << '\t'
+                     << result.n_chimers << '\t'
+                     << result.n_non_chimers << '\t'
+                     << chimer_fraction << '\t'
+                     << result.n_subchains << '\t'
+                     << get_n50(result.non_chimer_lengths) << '\t'
+                     << get_n50(result.chimer_lengths) << '\t'
+                     << get_n50(result.subchain_lengths) << '\n';
+            }
+        }
+    }
+}
+
+
+}
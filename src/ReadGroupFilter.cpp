@@ -0,0 +1,106 @@
+#include "ReadGroupFilter.hpp"
+#include "ReadNameTable.hpp"
+
+#include <functional>
+
+
+namespace liger2liger{
+
+
+ReadGroupFilter::ReadGroupFilter():
+    slots(initial_n_slots, 0),
+    n_closed(0)
+{}
+
+
+uint64_t ReadGroupFilter::hash(string_view name){
+    uint64_t h = mix_bits(std::hash<string_view>()(name));
+
+    return (h == 0) ? 1 : h;
+}
+
+
+bool ReadGroupFilter::contains(uint64_t h) const{
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = h & mask; slots[i] != 0; i = (i + 1) & mask){
+        if (slots[i] == h){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void ReadGroupFilter::insert(uint64_t h){
+    // Keep the load factor at or below 3/4, so that probe sequences stay short
+    if (4*(n_closed + 1) > 3*slots.size()){
+        vector<uint64_t> old_slots(2*slots.size(), 0);
+        std::swap(slots, old_slots);
+        n_closed = 0;
+
+        for (auto old_h: old_slots){
+            if (old_h != 0){
+                insert(old_h);
+            }
+        }
+    }
+
+    size_t mask = slots.size() - 1;
+    size_t i = h & mask;
+
+    while (slots[i] != 0){
+        if (slots[i] == h){
+            return;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    slots[i] = h;
+    n_closed++;
+}
+
+
+void ReadGroupFilter::close(string_view name){
+    insert(hash(name));
+}
+
+
+bool ReadGroupFilter::may_be_closed(string_view name){
+    uint64_t h = hash(name);
+
+    if (not contains(h)){
+        return false;
+    }
+
+    suspects.emplace(h);
+
+    return true;
+}
+
+
+bool ReadGroupFilter::verify(string_view name){
+    if (name == verify_name){
+        return true;
+    }
+
+    if (not verify_name.empty() and suspects.count(hash(verify_name)) > 0){
+        verify_closed.emplace(verify_name);
+    }
+
+    verify_name = name;
+
+    return verify_closed.count(verify_name) == 0;
+}
+
+
+void ReadGroupFilter::end_verifying(){
+    suspects.clear();
+    verify_name.clear();
+    verify_closed.clear();
+}
+
+
+}
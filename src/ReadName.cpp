@@ -0,0 +1,191 @@
+#include "ReadName.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+
+using std::runtime_error;
+using std::tie;
+
+
+namespace liger2liger{
+
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Bit offset, within ReadName::high, of the UUID version digit, which is the 13th of the 16 hex digits it holds
+static const uint64_t version_shift = 12;
+
+
+int32_t decode_hex_digit(char c){
+    if (c >= '0' and c <= '9'){
+        return c - '0';
+    }
+    if (c >= 'a' and c <= 'f'){
+        return c - 'a' + 10;
+    }
+
+    return -1;
+}
+
+
+bool pack_uuid(string_view name, ReadName& result){
+    if (name.size() != 36 or name[8] != '-' or name[13] != '-' or name[18] != '-' or name[23] != '-'){
+        return false;
+    }
+
+    uint64_t halves[2] = {0, 0};
+    size_t n_digits = 0;
+
+    for (size_t i=0; i<name.size(); i++){
+        if (i == 8 or i == 13 or i == 18 or i == 23){
+            continue;
+        }
+
+        auto digit = decode_hex_digit(name[i]);
+
+        if (digit < 0){
+            return false;
+        }
+
+        auto& half = halves[n_digits/16];
+        half = (half << 4) | uint64_t(digit);
+
+        n_digits++;
+    }
+
+    result.high = halves[0];
+    result.low = halves[1];
+
+    // Version 0 is reserved to mark arena keys
+    return result.is_uuid();
+}
+
+
+bool ReadName::is_uuid() const{
+    return ((high >> version_shift) & 0xf) != 0;
+}
+
+
+uint64_t ReadName::get_arena_offset() const{
+    return low;
+}
+
+
+uint32_t ReadName::get_arena_length() const{
+    return uint32_t(high >> 32);
+}
+
+
+bool ReadName::operator==(const ReadName& other) const{
+    return high == other.high and low == other.low;
+}
+
+
+bool ReadName::operator!=(const ReadName& other) const{
+    return not (*this == other);
+}
+
+
+ReadNameArena::ReadNameArena():
+    data(),
+    n_uuid(0),
+    n_other(0)
+{}
+
+
+ReadName ReadNameArena::encode(string_view name){
+    ReadName key;
+
+    if (pack_uuid(name, key)){
+        n_uuid++;
+        return key;
+    }
+
+    if (name.size() > UINT32_MAX){
+        throw runtime_error("ERROR: read name is too long to encode: " + string(name.substr(0, 100)) + "...");
+    }
+
+    key.high = uint64_t(name.size()) << 32;
+    key.low = data.size();
+
+    data.append(name);
+    n_other++;
+
+    return key;
+}
+
+
+string_view ReadNameArena::decode(const ReadName& key, char* buffer) const{
+    if (not key.is_uuid()){
+        return string_view(data).substr(key.get_arena_offset(), key.get_arena_length());
+    }
+
+    size_t n_digits = 0;
+
+    for (size_t i=0; i<36; i++){
+        if (i == 8 or i == 13 or i == 18 or i == 23){
+            buffer[i] = '-';
+            continue;
+        }
+
+        auto half = (n_digits < 16) ? key.high : key.low;
+        auto shift = 4*(15 - n_digits%16);
+
+        buffer[i] = hex_digits[(half >> shift) & 0xf];
+
+        n_digits++;
+    }
+
+    return string_view(buffer, 36);
+}
+
+
+string ReadNameArena::to_string(const ReadName& key) const{
+    char buffer[36];
+    return string(decode(key, buffer));
+}
+
+
+bool ReadNameArena::less(const ReadName& a, const ReadName& b) const{
+    // Lowercase hex digits sort the same way as their values, and the hyphens are in the same place in every UUID
+    if (a.is_uuid() and b.is_uuid()){
+        return tie(a.high, a.low) < tie(b.high, b.low);
+    }
+
+    char a_buffer[36];
+    char b_buffer[36];
+
+    return decode(a, a_buffer) < decode(b, b_buffer);
+}
+
+
+void ReadNameArena::clear(){
+    data.clear();
+    n_uuid = 0;
+    n_other = 0;
+}
+
+
+void ReadNameArena::write_stats(ostream& o) const{
+    // A std::string key is 32 bytes, plus a heap block for anything longer than its 15 char inline buffer. Glibc malloc
+    // blocks carry 8 bytes of overhead and are rounded up to multiples of 16, with a minimum of 32.
+    auto heap_bytes = [](size_t length){
+        if (length <= 15){
+            return size_t(0);
+        }
+        return std::max(size_t(32), (length + 1 + 8 + 15)/16*16);
+    };
+
+    size_t mean_other_length = n_other > 0 ? data.size()/n_other : 0;
+
+    size_t string_bytes = n_uuid*(32 + heap_bytes(36)) + n_other*(32 + heap_bytes(mean_other_length));
+    size_t key_bytes = (n_uuid + n_other)*sizeof(ReadName) + data.capacity();
+
+    o << "Read name keys: " << n_uuid << " UUID, " << n_other << " other (" << data.size() << " bytes in arena)" << '\n';
+    o << "Read name memory: " << key_bytes << " bytes, compared to about " << string_bytes << " bytes as std::string, "
+      << "saving " << (string_bytes > key_bytes ? string_bytes - key_bytes : 0) << " bytes" << '\n';
+}
+
+
+}
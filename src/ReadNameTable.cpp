@@ -0,0 +1,198 @@
+#include "ReadNameTable.hpp"
+
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <numeric>
+
+using std::runtime_error;
+
+
+namespace liger2liger{
+
+
+// Slot count of an empty table, which must be a power of 2
+static const size_t initial_n_slots = 16;
+
+
+uint64_t mix_bits(uint64_t x){
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111eb;
+    x ^= x >> 31;
+
+    return x;
+}
+
+
+uint64_t ReadNameTable::hash(const ReadName& key, string_view name){
+    if (key.is_uuid()){
+        return mix_bits(key.high ^ mix_bits(key.low));
+    }
+
+    return mix_bits(std::hash<string_view>()(name));
+}
+
+
+uint64_t ReadNameTable::hash(const ReadName& key) const{
+    char buffer[36];
+    return hash(key, arena.decode(key, buffer));
+}
+
+
+ReadNameTable::ReadNameTable():
+    arena(),
+    keys(),
+    slots(initial_n_slots, {0, empty_id})
+{}
+
+
+/// Probe for a name, leaving slot_index at the slot that holds it, or else at the empty slot where it belongs
+bool ReadNameTable::find_id(
+        string_view name,
+        uint64_t& name_hash,
+        ReadName& name_key,
+        size_t& slot_index,
+        uint32_t& id) const{
+
+    // Mark the key as an arena key if the name is not a UUID, so that it is hashed and compared by its text
+    if (not pack_uuid(name, name_key)){
+        name_key = {0, 0};
+    }
+
+    name_hash = hash(name_key, name);
+
+    size_t mask = slots.size() - 1;
+    uint32_t tag = uint32_t(name_hash >> 32);
+    char buffer[36];
+
+    for (slot_index = name_hash & mask; ; slot_index = (slot_index + 1) & mask){
+        auto& slot = slots[slot_index];
+
+        if (slot.id == empty_id){
+            return false;
+        }
+
+        if (slot.tag != tag){
+            continue;
+        }
+
+        auto& key = keys[slot.id];
+
+        if (name_key.is_uuid()){
+            if (key == name_key){
+                id = slot.id;
+                return true;
+            }
+        }
+        else if (not key.is_uuid() and arena.decode(key, buffer) == name){
+            id = slot.id;
+            return true;
+        }
+    }
+}
+
+
+bool ReadNameTable::find_id(string_view name, uint32_t& id) const{
+    uint64_t name_hash;
+    ReadName name_key;
+    size_t slot_index;
+
+    return find_id(name, name_hash, name_key, slot_index, id);
+}
+
+
+uint32_t ReadNameTable::get_id(string_view name){
+    // Keep the load factor at or below 3/4, so that probe sequences stay short
+    if ((keys.size() + 1)*4 > slots.size()*3){
+        resize(slots.size()*2);
+    }
+
+    uint64_t name_hash;
+    ReadName name_key;
+    size_t slot_index;
+    uint32_t id;
+
+    if (find_id(name, name_hash, name_key, slot_index, id)){
+        return id;
+    }
+
+    if (keys.size() >= empty_id){
+        throw runtime_error("ERROR: too many reads to assign ids: " + std::to_string(keys.size()));
+    }
+
+    id = keys.size();
+
+    keys.emplace_back(arena.encode(name));
+    slots[slot_index] = {uint32_t(name_hash >> 32), id};
+
+    return id;
+}
+
+
+void ReadNameTable::resize(size_t n_slots){
+    slots.assign(n_slots, {0, empty_id});
+
+    size_t mask = slots.size() - 1;
+
+    for (uint32_t id=0; id<keys.size(); id++){
+        auto key_hash = hash(keys[id]);
+
+        size_t i = key_hash & mask;
+        while (slots[i].id != empty_id){
+            i = (i + 1) & mask;
+        }
+
+        slots[i] = {uint32_t(key_hash >> 32), id};
+    }
+}
+
+
+string_view ReadNameTable::get_name(uint32_t id, char* buffer) const{
+    return arena.decode(keys.at(id), buffer);
+}
+
+
+string ReadNameTable::get_name(uint32_t id) const{
+    return arena.to_string(keys.at(id));
+}
+
+
+vector<uint32_t> ReadNameTable::get_sorted_ids() const{
+    vector<uint32_t> ids(keys.size());
+    std::iota(ids.begin(), ids.end(), 0);
+
+    std::sort(ids.begin(), ids.end(), [&](uint32_t a, uint32_t b){
+        return arena.less(keys[a], keys[b]);
+    });
+
+    return ids;
+}
+
+
+size_t ReadNameTable::size() const{
+    return keys.size();
+}
+
+
+bool ReadNameTable::empty() const{
+    return keys.empty();
+}
+
+
+void ReadNameTable::clear(){
+    arena.clear();
+    keys.clear();
+    std::fill(slots.begin(), slots.end(), Slot{0, empty_id});
+}
+
+
+void ReadNameTable::write_stats(ostream& o) const{
+    arena.write_stats(o);
+
+    o << "Read name index: " << slots.size() << " slots, " << slots.size()*sizeof(Slot) << " bytes" << '\n';
+}
+
+
+}
@@ -0,0 +1,148 @@
+#include "Region.hpp"
+
+#include <stdexcept>
+#include <fstream>
+#include <limits>
+#include <cctype>
+
+using std::numeric_limits;
+using std::runtime_error;
+using std::ifstream;
+
+
+namespace liger2liger{
+
+
+Region::Region(const string& contig, int64_t start, int64_t stop):
+    contig(contig),
+    start(start),
+    stop(stop)
+{
+    if (start < 0 or stop < start){
+        throw runtime_error("ERROR: invalid region bounds for contig " + contig + ": " + std::to_string(start) + "-" +
+                            std::to_string(stop));
+    }
+}
+
+
+int64_t parse_coordinate(const string& region, const string& token){
+    size_t n_parsed = 0;
+    int64_t result = -1;
+
+    try {
+        result = std::stoll(token, &n_parsed);
+    }
+    catch (const std::exception& e){
+        n_parsed = 0;
+    }
+
+    if (token.empty() or n_parsed != token.size()){
+        throw runtime_error("ERROR: could not parse coordinate '" + token + "' in region: " + region);
+    }
+
+    return result;
+}
+
+
+/// Whether a token is "start-stop", with nothing but digits on either side of the dash
+bool is_range(const string& token){
+    auto dash = token.find('-');
+
+    if (dash == string::npos or dash == 0 or dash + 1 == token.size()){
+        return false;
+    }
+
+    for (size_t i=0; i<token.size(); i++){
+        if (i != dash and not std::isdigit(static_cast<unsigned char>(token[i]))){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/// The range is parsed off the end, so that contig names may contain ':', as in HLA alleles. Anything that doesn't end in
+/// a range is taken as a whole contig, so a name whose last ':' is followed by something that looks like a range can't be
+/// used without one, which is the same ambiguity as in samtools.
+Region parse_region(const string& region){
+    auto colon = region.rfind(':');
+
+    if (colon == string::npos or not is_range(region.substr(colon + 1))){
+        return {region, 0, numeric_limits<int64_t>::max()};
+    }
+
+    auto dash = region.find('-', colon);
+
+    auto start = parse_coordinate(region, region.substr(colon + 1, dash - colon - 1));
+    auto stop = parse_coordinate(region, region.substr(dash + 1));
+
+    if (start < 1){
+        throw runtime_error("ERROR: region coordinates are 1-based: " + region);
+    }
+
+    return {region.substr(0, colon), start - 1, stop};
+}
+
+
+vector<Region> load_bed(path bed_path){
+    ifstream file(bed_path);
+
+    if (not file.good()){
+        throw runtime_error("ERROR: could not open BED file: " + bed_path.string());
+    }
+
+    vector<Region> regions;
+    string line;
+
+    while (getline(file, line)){
+        if (line.empty() or line[0] == '#' or line.rfind("track", 0) == 0 or line.rfind("browser", 0) == 0){
+            continue;
+        }
+
+        auto a = line.find('\t');
+        auto b = (a == string::npos) ? string::npos : line.find('\t', a + 1);
+
+        if (b == string::npos){
+            throw runtime_error("ERROR: BED line has fewer than 3 columns: " + line);
+        }
+
+        auto c = line.find('\t', b + 1);
+
+        regions.emplace_back(
+                line.substr(0, a),
+                parse_coordinate(line, line.substr(a + 1, b - a - 1)),
+                parse_coordinate(line, line.substr(b + 1, c == string::npos ? string::npos : c - b - 1)));
+    }
+
+    return regions;
+}
+
+
+vector<Region> parse_regions(const string& regions){
+    if (path(regions).extension() == ".bed"){
+        return load_bed(regions);
+    }
+
+    vector<Region> result;
+    size_t start = 0;
+
+    while (start <= regions.size()){
+        auto stop = regions.find(',', start);
+
+        if (stop == string::npos){
+            stop = regions.size();
+        }
+
+        if (stop > start){
+            result.emplace_back(parse_region(regions.substr(start, stop - start)));
+        }
+
+        start = stop + 1;
+    }
+
+    return result;
+}
+
+
+}
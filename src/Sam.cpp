@@ -1,17 +1,14 @@
 #include "Sam.hpp"
+#include "DelimiterScanner.hpp"
 #include "htslib/include/htslib/hts.h"
 #include "htslib/include/htslib/sam.h"
 
 #include <stdexcept>
-#include <iostream>
-#include <istream>
-#include <limits>
+#include <charconv>
 
-using std::numeric_limits;
 using std::runtime_error;
-using std::streamsize;
-using std::ifstream;
-using std::cerr;
+using std::from_chars;
+using std::errc;
 
 namespace liger2liger {
 
@@ -45,6 +42,9 @@ SamElement::SamElement(string& read_name, string& ref_name, uint16_t flag, uint8
 SamElement::SamElement() :
         query_name(),
         ref_name(),
+        query_length(0),
+        ref_length(0),
+        ref_start(0),
         flag(-1),
         mapq(-1)
 {}
@@ -102,63 +102,172 @@ void SamElement::for_each_cigar(const function<void(char type, uint32_t length)>
 }
 
 
-void for_element_in_sam_file(path sam_path, const function<void(SamElement& e)>& f){
-    ifstream file(sam_path);
+static const size_t n_sam_fields = 11;
+
+
+template<class T> T parse_sam_integer(string_view token){
+    T value = 0;
+
+    auto result = from_chars(token.data(), token.data() + token.size(), value);
 
-    if (not file.is_open() or not file.good()){
-        throw runtime_error("ERROR: could not read input file: " + sam_path.string());
+    if (result.ec != errc() or result.ptr != token.data() + token.size()){
+        throw runtime_error("ERROR: could not parse integer in SAM column: " + string(token));
     }
 
-    char c;
-    size_t n_delimiters = 0;
-    int64_t n_lines = 0;
+    return value;
+}
 
-    string read_name;
-    string flag_token;
-    string ref_name;
-    string mapq_token;
 
-    char header_delimiter = '@';
+bool SamRecord::is_reverse() const {
+    return flag & BAM_FREVERSE;
+}
+
+
+bool SamRecord::is_primary() const {
+    return not (flag & (BAM_FSECONDARY | BAM_FSUPPLEMENTARY));
+}
+
+
+bool parse_sam_line(string_view line, SamRecord& record){
+    string_view fields[n_sam_fields];
+
+    const char* cursor = line.data();
+    const char* end = line.data() + line.size();
+
+    size_t n_fields = 0;
+
+    while (n_fields < n_sam_fields) {
+        auto tab = find_delimiter(cursor, end, '\t');
 
-    // If this is a header line, skip to the next line and increment n_lines until we are no longer on a header
-    while (file.peek() == header_delimiter){
-        cerr << string(1, char(file.peek())) << '\n';
-        file.ignore(numeric_limits<streamsize>::max(), '\n');
-        n_lines++;
+        fields[n_fields++] = string_view(cursor, tab - cursor);
+
+        cursor = tab;
+
+        if (tab == end){
+            break;
+        }
+
+        cursor++;
     }
 
-    while (file.get(c)){
-        if (c == '\n'){
-            n_delimiters = 0;
+    if (n_fields < n_sam_fields){
+        return false;
+    }
+
+    record.query_name = fields[0];
+    record.flag = parse_sam_integer<uint16_t>(fields[1]);
+    record.ref_name = fields[2];
+    record.ref_start = parse_sam_integer<int64_t>(fields[3]) - 1;
+    record.map_quality = parse_sam_integer<uint32_t>(fields[4]);
+    record.cigar = fields[5];
 
-            SamElement e(read_name, ref_name, int16_t(stoi(flag_token)), int8_t(stoi(mapq_token)));
+    // RNEXT, PNEXT, TLEN, SEQ and QUAL are skipped, and everything remaining is optional tags
+    record.tags.index(string_view(cursor, end - cursor));
+
+    return true;
+}
 
-            f(e);
 
-            read_name.clear();
-            flag_token.clear();
-            ref_name.clear();
-            mapq_token.clear();
+SamReader::SamReader(path sam_path, size_t n_threads):
+    file(sam_path, n_threads),
+    has_pending_line(false)
+{
+    string_view line;
 
-            n_lines++;
+    while (file.next_line(line)) {
+        if (line.empty() or line[0] != '@') {
+            pending_line = line;
+            has_pending_line = true;
+            break;
         }
-        else if (c == '\t'){
-            n_delimiters++;
+
+        if (line.substr(0, 4) != "@SQ\t") {
+            continue;
         }
-        else{
-            if (n_delimiters == 0){
-                read_name += c;
-            }
-            else if (n_delimiters == 1){
-                flag_token += c;
-            }
-            else if (n_delimiters == 2){
-                ref_name += c;
+
+        // @SQ  SN:name  LN:length, in any order
+        string_view name;
+        string_view length;
+
+        auto cursor = line.data() + 4;
+        auto end = line.data() + line.size();
+
+        while (cursor < end) {
+            auto tab = find_delimiter(cursor, end, '\t');
+            string_view field(cursor, tab - cursor);
+
+            if (field.substr(0, 3) == "SN:") {
+                name = field.substr(3);
             }
-            else if (n_delimiters == 4){
-                mapq_token += c;
+            else if (field.substr(0, 3) == "LN:") {
+                length = field.substr(3);
             }
+
+            cursor = tab + 1;
         }
+
+        if (name.empty() or length.empty()) {
+            throw runtime_error("ERROR: SAM @SQ header line is missing SN or LN: " + string(line));
+        }
+
+        ref_lengths[string(name)] = parse_sam_integer<uint32_t>(length);
+    }
+}
+
+
+bool SamReader::next_record(SamRecord& record){
+    string_view line;
+
+    if (has_pending_line) {
+        line = pending_line;
+        has_pending_line = false;
+    }
+    else {
+        do {
+            if (not file.next_line(line)) {
+                return false;
+            }
+        } while (line.empty());
+    }
+
+    if (not parse_sam_line(line, record)) {
+        throw runtime_error("ERROR: SAM line does not have 11 tab separated columns: " + string(line));
+    }
+
+    return true;
+}
+
+
+uint32_t SamReader::get_ref_length(string_view ref_name) const{
+    if (ref_name == "*") {
+        return 0;
+    }
+
+    auto result = ref_lengths.find(string(ref_name));
+
+    if (result == ref_lengths.end()) {
+        throw runtime_error("ERROR: SAM header has no @SQ line for contig: " + string(ref_name));
+    }
+
+    return result->second;
+}
+
+
+void for_element_in_sam_file(path sam_path, const function<void(SamElement& e)>& f){
+    SamReader reader(sam_path, 1);
+    SamRecord record;
+
+    string read_name;
+    string ref_name;
+
+    while (reader.next_record(record)) {
+        read_name = record.query_name;
+        ref_name = record.ref_name;
+
+        SamElement e(read_name, ref_name, record.flag, uint8_t(record.map_quality));
+        e.ref_start = int32_t(record.ref_start);
+
+        f(e);
     }
 }
 
@@ -0,0 +1,223 @@
+#include "AlignmentChain.hpp"
+#include "Filesystem.hpp"
+#include "Bam.hpp"
+#include "CLI11.hpp"
+
+#include <iostream>
+#include <string>
+#include <chrono>
+
+using ghc::filesystem::file_size;
+using ghc::filesystem::path;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+using std::to_string;
+using std::string;
+using std::runtime_error;
+using std::cerr;
+
+using liger2liger::AlignmentChains;
+using liger2liger::ChainElement;
+using liger2liger::SamElement;
+using liger2liger::Bam;
+
+
+double time_seconds(steady_clock::time_point t0){
+    return double(duration_cast<milliseconds>(steady_clock::now() - t0).count())/1000;
+}
+
+
+/// The conversion that AlignmentChains::load_from_bam used before reading spans straight from bam1_t: a SamElement with
+/// string and CIGAR copies per record, and a callback per CIGAR operation. Kept only as the reference point for this
+/// benchmark.
+void legacy_load_from_bam(AlignmentChains& chains, path bam_path, size_t n_threads){
+    Bam reader(bam_path, n_threads);
+
+    reader.for_alignment_in_bam(true, [&](const SamElement& alignment){
+        uint32_t start_clip = 0;
+        uint32_t end_clip = 0;
+        uint32_t query_start;
+        uint32_t query_stop;
+        uint32_t query_length;
+        uint32_t ref_start;
+        uint32_t ref_stop;
+        uint32_t ref_length;
+        uint32_t alignment_length;
+        uint32_t n_matches = 0;
+        uint32_t n_inserts = 0;
+        uint32_t n_deletes = 0;
+        uint32_t n_n = 0;
+
+        size_t i = 0;
+
+        alignment.for_each_cigar([&](char type, uint32_t length){
+            if (type == 'M' or type == 'X' or type == '='){
+                n_matches += length;
+            }
+            else if (type == 'I'){
+                n_inserts += length;
+            }
+            else if (type == 'D'){
+                n_deletes += length;
+            }
+            else if (type == 'N'){
+                n_n += length;
+            }
+            else if (type == 'S' or type == 'H'){
+                if (i == 0){
+                    start_clip = length;
+                }
+                else{
+                    end_clip = length;
+                }
+            }
+
+            i++;
+        });
+
+        query_length = n_matches + n_inserts + start_clip + end_clip;
+        alignment_length = n_matches + n_inserts + n_deletes;
+        ref_start = alignment.ref_start;
+        ref_stop = ref_start + n_matches + n_deletes;
+        ref_length = alignment.ref_length;
+
+        if (alignment.is_reverse()){
+            query_start = end_clip;
+            query_stop = query_length - start_clip;
+        }
+        else{
+            query_start = start_clip;
+            query_stop = query_length - end_clip;
+        }
+
+        ChainElement e(
+                chains.contigs.get_id(alignment.ref_name, alignment.ref_length),
+                ref_start,
+                ref_stop,
+                query_start,
+                query_stop,
+                ref_length,
+                query_length,
+                n_matches,
+                alignment_length,
+                uint32_t(alignment.mapq),
+                alignment.is_reverse());
+
+        if (AlignmentChains::is_usable(e)){
+            chains.add(alignment.query_name, e);
+        }
+    });
+}
+
+
+bool chains_equal(AlignmentChains& a, AlignmentChains& b){
+    if (a.read_names.size() != b.read_names.size() or a.elements.size() != b.elements.size()){
+        return false;
+    }
+
+    for (uint32_t id=0; id<a.read_names.size(); id++){
+        auto chain = a.get_chain(id);
+        auto other_chain = b.get_chain(id);
+
+        if (a.read_names.get_name(id) != b.read_names.get_name(id) or chain.size() != other_chain.size()){
+            return false;
+        }
+
+        for (size_t i=0; i<chain.size(); i++){
+            auto x = chain[i];
+            auto y = other_chain[i];
+
+            if (a.contigs.get_name(x.contig_id) != b.contigs.get_name(y.contig_id) or x.ref_start != y.ref_start or
+                x.ref_stop != y.ref_stop or x.query_start != y.query_start or x.query_stop != y.query_stop or
+                x.ref_length != y.ref_length or x.query_length != y.query_length or
+                x.residue_matches != y.residue_matches or x.alignment_length != y.alignment_length or
+                x.map_quality != y.map_quality or x.is_reverse != y.is_reverse){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/// Report decompression and loading throughput for every power of 2 number of decompression threads up to max_threads.
+/// "decode" only iterates the records, so it is bounded by decompression, while "load" also builds the chains, and
+/// "legacy_load" builds them through SamElement as load_from_bam used to.
+void benchmark(path bam_path, size_t max_threads){
+    double n_megabytes = double(file_size(bam_path))/(1024*1024);
+    double decode_reference = 0;
+    double load_reference = 0;
+    double legacy_reference = 0;
+
+    cerr << "step" << '\t' << "threads" << '\t' << "seconds" << '\t' << "MB/s" << '\t' << "records/s" << '\t'
+         << "speedup" << '\n';
+
+    auto report = [&](const string& name, size_t n_threads, double seconds, size_t n_records, double& reference){
+        if (reference == 0){
+            reference = seconds;
+        }
+
+        cerr << name << '\t' << n_threads << '\t' << seconds << '\t' << n_megabytes/seconds << '\t'
+             << double(n_records)/seconds << '\t' << reference/seconds << "x" << '\n';
+    };
+
+    for (size_t n_threads=1; n_threads <= max_threads; n_threads *= 2){
+        {
+            size_t n_records = 0;
+
+            auto t0 = steady_clock::now();
+            Bam reader(bam_path, n_threads);
+
+            reader.for_alignment_in_bam(false, [&](SamElement&){
+                n_records++;
+            });
+
+            report("decode", n_threads, time_seconds(t0), n_records, decode_reference);
+        }
+
+        AlignmentChains chains;
+
+        auto t0 = steady_clock::now();
+        chains.load_from_bam(bam_path, n_threads);
+
+        report("load", n_threads, time_seconds(t0), chains.elements.size(), load_reference);
+
+        AlignmentChains legacy_chains;
+
+        t0 = steady_clock::now();
+        legacy_load_from_bam(legacy_chains, bam_path, n_threads);
+
+        report("legacy_load", n_threads, time_seconds(t0), legacy_chains.elements.size(), legacy_reference);
+
+        if (not chains_equal(chains, legacy_chains)){
+            throw runtime_error("ERROR: load_from_bam result does not match legacy SamElement conversion");
+        }
+    }
+}
+
+
+int main(int argc, char* argv[]){
+    path bam_path;
+    size_t max_threads = 8;
+
+    CLI::App app{"Measure how BAM decompression and loading scale with the number of htslib decompression threads"};
+
+    app.add_option(
+            "-i,--bam_path",
+            bam_path,
+            "File path of BAM file to read")
+            ->required();
+
+    app.add_option(
+            "-t,--max_threads",
+            max_threads,
+            "Time every power of 2 number of decompression threads up to this many");
+
+    CLI11_PARSE(app, argc, argv);
+
+    benchmark(bam_path, max_threads);
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include "AlignmentChain.hpp"
+#include "BgzfLineReader.hpp"
+#include "Filesystem.hpp"
+#include "CLI11.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using ghc::filesystem::path;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+using std::runtime_error;
+using std::to_string;
+using std::string;
+using std::vector;
+using std::cerr;
+
+using liger2liger::AlignmentChains;
+using liger2liger::AlignmentChain;
+using liger2liger::ChainStore;
+using liger2liger::PafSource;
+using liger2liger::is_stream_path;
+
+
+/// The sort that AlignmentChain::sort_chain used before it was specialized by length: a floating point midpoint per
+/// element, and std::sort of every chain. Kept only as the reference point for this benchmark.
+void legacy_sort_chain(ChainStore& store, size_t offset, size_t length){
+    vector<double> midpoints(length);
+    vector<uint32_t> order(length);
+
+    for (size_t i=0; i<length; i++){
+        midpoints[i] = (double(store.query_stops[offset + i]) + double(store.query_starts[offset + i])) / 2;
+        order[i] = i;
+    }
+
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){
+        return midpoints[a] < midpoints[b];
+    });
+
+    store.permute(offset, order);
+}
+
+
+/// Label of the sort_chain path that a chain of this length takes, in the same bins as its size thresholds
+string get_size_bin(size_t length){
+    if (length <= 4){
+        return to_string(length);
+    }
+    if (length <= 16){
+        return "5-16";
+    }
+    if (length < 256){
+        return "17-255";
+    }
+
+    return "256+";
+}
+
+
+double time_seconds(steady_clock::time_point t0){
+    return double(duration_cast<microseconds>(steady_clock::now() - t0).count())/1e6;
+}
+
+
+/// Sort every chain of a real alignment file, so that chains come in the size distribution of real data, with the
+/// current sort_chain and with the legacy sort. Each repeat sorts a fresh copy of the unsorted elements. Results are
+/// compared by midpoint only, since the legacy sort leaves ties in no particular order.
+void benchmark(path paf_path, size_t n_repeats){
+    AlignmentChains chains;
+
+    if (is_stream_path(paf_path)){
+        PafSource source(paf_path, 1);
+        chains.load(source);
+    }
+    else{
+        chains.load_from_paf_mmap(paf_path);
+    }
+
+    size_t n_reads = chains.read_names.size();
+
+    // Grouping the store makes every chain a contiguous range, which both sorts then reorder in place
+    chains.elements.group_by_read(n_reads);
+
+    vector<size_t> offsets(n_reads);
+    vector<size_t> lengths(n_reads);
+
+    vector<string> bins = {"1", "2", "3", "4", "5-16", "17-255", "256+"};
+    vector<size_t> bin_reads(bins.size(), 0);
+    vector<size_t> bin_elements(bins.size(), 0);
+
+    for (uint32_t id=0; id<n_reads; id++){
+        offsets[id] = chains.elements.get_offset(id);
+        lengths[id] = chains.elements.get_length(id);
+
+        auto bin = std::find(bins.begin(), bins.end(), get_size_bin(lengths[id])) - bins.begin();
+        bin_reads[bin]++;
+        bin_elements[bin] += lengths[id];
+    }
+
+    cerr << "chain_length" << '\t' << "reads" << '\t' << "elements" << '\n';
+
+    for (size_t i=0; i<bins.size(); i++){
+        cerr << bins[i] << '\t' << bin_reads[i] << '\t' << bin_elements[i] << '\n';
+    }
+
+    cerr << '\n' << "sort" << '\t' << "seconds" << '\t' << "ns/read" << '\n';
+
+    ChainStore sorted;
+    ChainStore legacy_sorted;
+
+    for (size_t r=0; r<n_repeats; r++){
+        sorted = chains.elements;
+
+        auto t0 = steady_clock::now();
+
+        for (uint32_t id=0; id<n_reads; id++){
+            AlignmentChain chain(sorted, offsets[id], lengths[id]);
+            chain.sort_chain();
+        }
+
+        double seconds = time_seconds(t0);
+        cerr << "sort_chain" << '\t' << seconds << '\t' << seconds*1e9/double(n_reads) << '\n';
+
+        legacy_sorted = chains.elements;
+
+        t0 = steady_clock::now();
+
+        for (uint32_t id=0; id<n_reads; id++){
+            legacy_sort_chain(legacy_sorted, offsets[id], lengths[id]);
+        }
+
+        seconds = time_seconds(t0);
+        cerr << "legacy" << '\t' << seconds << '\t' << seconds*1e9/double(n_reads) << '\n';
+    }
+
+    for (size_t i=0; i<sorted.size(); i++){
+        if (uint64_t(sorted.query_starts[i]) + sorted.query_stops[i] !=
+            uint64_t(legacy_sorted.query_starts[i]) + legacy_sorted.query_stops[i]){
+            throw runtime_error("ERROR: sort_chain result does not match legacy sort at element " + to_string(i));
+        }
+    }
+
+    cerr << "Results identical" << '\n';
+}
+
+
+int main(int argc, char* argv[]){
+    path paf_path;
+    size_t n_repeats = 3;
+
+    CLI::App app{"Compare the runtime of sorting every chain of a real PAF file, by chain length, against the legacy sort"};
+
+    app.add_option(
+            "-i,--paf_path",
+            paf_path,
+            "File path of PAF file to load, which may be gzipped or bgzipped")
+            ->required();
+
+    app.add_option(
+            "-n,--n_repeats",
+            n_repeats,
+            "How many times to sort the chains with each method");
+
+    CLI11_PARSE(app, argc, argv);
+
+    benchmark(paf_path, n_repeats);
+
+    return 0;
+}
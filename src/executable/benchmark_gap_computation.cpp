@@ -0,0 +1,146 @@
+#include "AlignmentChain.hpp"
+#include "DelimiterScanner.hpp"
+#include "GapKernel.hpp"
+#include "Filesystem.hpp"
+#include "CLI11.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using ghc::filesystem::path;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+using std::runtime_error;
+using std::string;
+using std::vector;
+using std::cerr;
+
+using liger2liger::get_supported_simd_level;
+using liger2liger::set_simd_level;
+using liger2liger::AlignmentChains;
+using liger2liger::AlignmentChain;
+using liger2liger::PafSource;
+using liger2liger::SimdLevel;
+using liger2liger::is_stream_path;
+
+
+double time_seconds(steady_clock::time_point t0){
+    return double(duration_cast<microseconds>(steady_clock::now() - t0).count())/1e6;
+}
+
+
+/// Compute the gaps of every chain of a real alignment file, once sorted, pair by pair with
+/// AlignmentChain::compute_distance as split used to, and in one batch over the whole store at each SIMD level. Every
+/// batch must give the same gaps as the pairwise calls.
+void benchmark(path paf_path, size_t n_repeats){
+    AlignmentChains chains;
+
+    if (is_stream_path(paf_path)){
+        PafSource source(paf_path, 1);
+        chains.load(source);
+    }
+    else{
+        chains.load_from_paf_mmap(paf_path);
+    }
+
+    chains.for_each_chain([&](string_view, AlignmentChain& chain){
+        chain.sort_chain();
+    }, liger2liger::ReadOrder::first_seen);
+
+    size_t n_reads = chains.read_names.size();
+    size_t n_elements = chains.elements.size();
+
+    vector<AlignmentChain> all_chains;
+
+    for (uint32_t id=0; id<n_reads; id++){
+        all_chains.emplace_back(chains.get_chain(id));
+    }
+
+    cerr << "reads" << '\t' << n_reads << '\n';
+    cerr << "elements" << '\t' << n_elements << '\n';
+    cerr << '\n' << "method" << '\t' << "seconds" << '\t' << "ns/element" << '\n';
+
+    // Pairwise gaps go into the same layout as the store, so that they can be compared directly
+    vector<uint32_t> pairwise_gaps(n_elements, 0);
+
+    for (size_t r=0; r<n_repeats; r++){
+        auto t0 = steady_clock::now();
+
+        size_t offset = 0;
+        for (auto& chain: all_chains){
+            for (size_t i=0; i+1<chain.size(); i++){
+                pairwise_gaps[offset + i] = chain.compute_distance(i, i + 1);
+            }
+            offset += chain.size();
+        }
+
+        double seconds = time_seconds(t0);
+        cerr << "pairwise" << '\t' << seconds << '\t' << seconds*1e9/double(n_elements) << '\n';
+    }
+
+    vector<SimdLevel> levels = {SimdLevel::scalar, SimdLevel::avx2};
+    vector<uint32_t> gaps;
+
+    for (auto level: levels){
+        if (level > get_supported_simd_level()){
+            cerr << "skipping unsupported level: " << to_string(level) << '\n';
+            continue;
+        }
+
+        set_simd_level(level);
+
+        for (size_t r=0; r<n_repeats; r++){
+            auto t0 = steady_clock::now();
+
+            chains.compute_gaps(gaps);
+
+            double seconds = time_seconds(t0);
+            cerr << "batch_" << to_string(level) << '\t' << seconds << '\t' << seconds*1e9/double(n_elements) << '\n';
+        }
+
+        // The last gap of each chain spans into the next one, so it is not compared
+        size_t offset = 0;
+        for (auto& chain: all_chains){
+            for (size_t i=0; i+1<chain.size(); i++){
+                if (gaps[offset + i] != pairwise_gaps[offset + i]){
+                    throw runtime_error("ERROR: batch gap does not match compute_distance at element " +
+                                        std::to_string(offset + i) + " with SIMD level " + to_string(level));
+                }
+            }
+            offset += chain.size();
+        }
+    }
+
+    set_simd_level(get_supported_simd_level());
+
+    cerr << "Results identical" << '\n';
+}
+
+
+int main(int argc, char* argv[]){
+    path paf_path;
+    size_t n_repeats = 3;
+
+    CLI::App app{"Compare the runtime of computing the gaps between neighbouring alignments of every chain of a real PAF "
+                 "file, pair by pair and in one batch at each SIMD level"};
+
+    app.add_option(
+            "-i,--paf_path",
+            paf_path,
+            "File path of PAF file to load, which may be gzipped or bgzipped")
+            ->required();
+
+    app.add_option(
+            "-n,--n_repeats",
+            n_repeats,
+            "How many times to compute the gaps with each method");
+
+    CLI11_PARSE(app, argc, argv);
+
+    benchmark(paf_path, n_repeats);
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "AlignmentChain.hpp"
+#include "Filesystem.hpp"
+#include "CLI11.hpp"
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <chrono>
+
+using ghc::filesystem::file_size;
+using ghc::filesystem::path;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+using std::runtime_error;
+using std::function;
+using std::to_string;
+using std::string;
+using std::cerr;
+
+using liger2liger::AlignmentChains;
+using liger2liger::AlignmentChain;
+using liger2liger::ChainElement;
+
+
+bool elements_equal(const ChainElement& a, const ChainElement& b){
+    return a.contig_id == b.contig_id and
+           a.ref_start == b.ref_start and
+           a.ref_stop == b.ref_stop and
+           a.query_start == b.query_start and
+           a.query_stop == b.query_stop and
+           a.ref_length == b.ref_length and
+           a.query_length == b.query_length and
+           a.residue_matches == b.residue_matches and
+           a.alignment_length == b.alignment_length and
+           a.map_quality == b.map_quality and
+           a.is_reverse == b.is_reverse;
+}
+
+
+/// Every loader assigns read ids in order of first appearance in the file, so ids must match too
+bool chains_equal(AlignmentChains& a, AlignmentChains& b){
+    if (a.read_names.size() != b.read_names.size()){
+        return false;
+    }
+
+    for (uint32_t id=0; id<a.read_names.size(); id++){
+        auto chain = a.get_chain(id);
+        auto other_chain = b.get_chain(id);
+
+        if (a.read_names.get_name(id) != b.read_names.get_name(id) or chain.size() != other_chain.size()){
+            return false;
+        }
+
+        for (size_t i=0; i<chain.size(); i++){
+            if (not elements_equal(chain[i], other_chain[i])){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+void time_loader(
+        const string& name,
+        path paf_path,
+        size_t n_repeats,
+        AlignmentChains& result,
+        const function<void(AlignmentChains& chains, path paf_path)>& load){
+
+    double n_megabytes = double(file_size(paf_path))/(1024*1024);
+
+    for (size_t i=0; i<n_repeats; i++){
+        AlignmentChains chains;
+
+        auto t0 = steady_clock::now();
+        load(chains, paf_path);
+        auto t1 = steady_clock::now();
+
+        double seconds = double(duration_cast<milliseconds>(t1 - t0).count())/1000;
+
+        cerr << name << '\t' << seconds << " s" << '\t' << n_megabytes/seconds << " MB/s" << '\t' << chains.read_names.size() << " reads" << '\n';
+
+        if (i + 1 == n_repeats){
+            result = std::move(chains);
+        }
+    }
+}
+
+
+void benchmark(path paf_path, size_t n_repeats, size_t max_threads){
+    AlignmentChains buffered_result;
+    AlignmentChains mmap_result;
+
+    time_loader("buffered", paf_path, n_repeats, buffered_result, [&](AlignmentChains& chains, path p){
+        chains.load_from_paf(p);
+    });
+
+    time_loader("mmap", paf_path, n_repeats, mmap_result, [&](AlignmentChains& chains, path p){
+        chains.load_from_paf_mmap(p);
+    });
+
+    if (not chains_equal(buffered_result, mmap_result)){
+        throw runtime_error("ERROR: mmap loader result does not match buffered loader");
+    }
+
+    for (size_t n_threads=1; n_threads <= max_threads; n_threads *= 2){
+        AlignmentChains parallel_result;
+
+        time_loader("parallel_" + to_string(n_threads), paf_path, n_repeats, parallel_result, [&](AlignmentChains& chains, path p){
+            chains.load_from_paf_parallel(p, n_threads);
+        });
+
+        if (not chains_equal(buffered_result, parallel_result)){
+            throw runtime_error("ERROR: parallel loader result does not match buffered loader for n_threads=" + to_string(n_threads));
+        }
+    }
+
+    cerr << "Results identical" << '\n';
+}
+
+
+int main(int argc, char* argv[]){
+    path paf_path;
+    size_t n_repeats = 3;
+    size_t max_threads = 1;
+
+    CLI::App app{"Compare the runtime of the available PAF loaders on a real PAF file"};
+
+    app.add_option(
+            "-i,--paf_path",
+            paf_path,
+            "File path of PAF file to load")
+            ->required();
+
+    app.add_option(
+            "-n,--n_repeats",
+            n_repeats,
+            "How many times to load the file with each loader");
+
+    app.add_option(
+            "-t,--max_threads",
+            max_threads,
+            "Time the parallel loader for every power of 2 number of threads up to this many");
+
+    CLI11_PARSE(app, argc, argv);
+
+    benchmark(paf_path, n_repeats, max_threads);
+
+    return 0;
+}
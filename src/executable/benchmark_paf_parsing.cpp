@@ -0,0 +1,204 @@
+#include "DelimiterScanner.hpp"
+#include "MappedFile.hpp"
+#include "PafRecord.hpp"
+#include "CLI11.hpp"
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::uniform_int_distribution;
+using std::runtime_error;
+using std::mt19937;
+using std::function;
+using std::to_string;
+using std::string;
+using std::vector;
+using std::cerr;
+
+using liger2liger::for_line_in_buffer;
+using liger2liger::get_supported_simd_level;
+using liger2liger::set_simd_level;
+using liger2liger::parse_paf_line;
+using liger2liger::find_delimiter;
+using liger2liger::MappedFile;
+using liger2liger::PafRecord;
+using liger2liger::SimdLevel;
+
+
+/// Minimap2-like lines, with the same columns and tags as `minimap2 -x map-ont` output
+string generate_paf(size_t n_lines){
+    mt19937 generator(0);
+    uniform_int_distribution<uint32_t> coordinate(0, 1000000);
+    uniform_int_distribution<uint32_t> hex(0, 15);
+
+    string result;
+
+    for (size_t i=0; i<n_lines; i++){
+        string name;
+        for (size_t j=0; j<36; j++){
+            name += (j == 8 or j == 13 or j == 18 or j == 23) ? '-' : "0123456789abcdef"[hex(generator)];
+        }
+
+        auto a = coordinate(generator);
+        auto b = a + coordinate(generator)%20000;
+
+        result += name + '\t' + to_string(b + 100) + '\t' + to_string(a) + '\t' + to_string(b) + '\t' + ((a % 2) ? '+' : '-');
+        result += "\tchr" + to_string(a % 22 + 1) + '\t' + to_string(248956422) + '\t' + to_string(a*2) + '\t' + to_string(b*2);
+        result += '\t' + to_string((b - a)*9/10) + '\t' + to_string(b - a + 10) + '\t' + to_string(a % 61);
+        result += "\ttp:A:P\tcm:i:" + to_string(a % 500) + "\ts1:i:" + to_string(a % 3000) + "\ts2:i:0\tdv:f:0.0123\trl:i:56\n";
+    }
+
+    return result;
+}
+
+
+/// The tokenizer that AlignmentChains::add_alignment used before delimiter scanning: one branch per character, and
+/// one stoi (with a string allocation) per numeric column. Kept only as the reference point for this benchmark.
+uint64_t legacy_parse(const string& line){
+    string token;
+    uint64_t checksum = 0;
+    uint64_t n_delimiters = 0;
+
+    for (char c: line) {
+        if (c == '\t') {
+            if (n_delimiters == 0 or n_delimiters == 5) {
+                checksum += token.size();
+            } else if (n_delimiters == 4) {
+                checksum += (token == "-");
+            } else if (n_delimiters < 12) {
+                checksum += stoi(token);
+            } else if (n_delimiters == 13) {
+                checksum += stoi(token.substr(5, token.size() - 5));
+            }
+
+            token.resize(0);
+            n_delimiters++;
+        } else {
+            token += c;
+        }
+    }
+
+    return checksum;
+}
+
+
+uint64_t record_checksum(const PafRecord& r){
+    int64_t n_minimizers = 0;
+    r.tags.get_int(liger2liger::PafTags::n_minimizers, n_minimizers);
+
+    return r.query_name.size() + r.ref_name.size() + r.is_reverse + r.query_length + r.query_start + r.query_stop +
+           r.ref_length + r.ref_start + r.ref_stop + r.residue_matches + r.alignment_length + r.map_quality +
+           n_minimizers;
+}
+
+
+double time_function(const string& name, size_t n_lines, double reference_seconds, const function<uint64_t()>& f){
+    auto t0 = steady_clock::now();
+    auto checksum = f();
+    auto t1 = steady_clock::now();
+
+    double seconds = double(duration_cast<nanoseconds>(t1 - t0).count())/1e9;
+
+    cerr << name << '\t' << seconds << " s" << '\t' << double(n_lines)/seconds/1e6 << " M lines/s";
+
+    if (reference_seconds > 0){
+        cerr << '\t' << reference_seconds/seconds << "x";
+    }
+
+    cerr << '\t' << "checksum=" << checksum << '\n';
+
+    return seconds;
+}
+
+
+void benchmark(string paf){
+    size_t n_lines = 0;
+
+    // Copy lines out ahead of time so the legacy path is only charged for tokenizing, as it was in add_alignment
+    vector<string> lines;
+    for_line_in_buffer(paf, [&](string_view line){
+        lines.emplace_back(line);
+        n_lines++;
+    });
+
+    double legacy_seconds = time_function("legacy_stoi", n_lines, 0, [&](){
+        uint64_t checksum = 0;
+        for (auto& line: lines){
+            checksum += legacy_parse(line + '\t');
+        }
+        return checksum;
+    });
+
+    vector<SimdLevel> levels = {SimdLevel::scalar, SimdLevel::sse2, SimdLevel::avx2};
+
+    for (auto level: levels){
+        if (level > get_supported_simd_level()){
+            cerr << "skipping unsupported level: " << to_string(level) << '\n';
+            continue;
+        }
+
+        set_simd_level(level);
+
+        time_function("scan_newlines_" + to_string(level), n_lines, 0, [&](){
+            uint64_t checksum = 0;
+            for_line_in_buffer(paf, [&](string_view line){
+                checksum += line.size();
+            });
+            return checksum;
+        });
+
+        time_function("parse_" + to_string(level), n_lines, legacy_seconds, [&](){
+            uint64_t checksum = 0;
+            PafRecord record;
+
+            for_line_in_buffer(paf, [&](string_view line){
+                if (not parse_paf_line(line, record)){
+                    throw runtime_error("ERROR: could not parse line: " + string(line));
+                }
+                checksum += record_checksum(record);
+            });
+
+            return checksum;
+        });
+    }
+
+    set_simd_level(get_supported_simd_level());
+}
+
+
+int main(int argc, char* argv[]){
+    path paf_path;
+    size_t n_lines = 2000000;
+
+    CLI::App app{"Microbenchmark of the PAF tokenizer, comparing the old per-character stoi parsing to vectorized "
+                 "delimiter scanning at each SIMD level. Checksums of the decoded columns should agree."};
+
+    app.add_option(
+            "-i,--paf_path",
+            paf_path,
+            "Optional PAF file to parse. If not provided, minimap2-like lines are generated");
+
+    app.add_option(
+            "-n,--n_lines",
+            n_lines,
+            "How many lines to generate if no PAF is provided");
+
+    CLI11_PARSE(app, argc, argv);
+
+    if (paf_path.empty()){
+        benchmark(generate_paf(n_lines));
+    }
+    else {
+        MappedFile paf_file(paf_path);
+        benchmark(string(paf_file.view()));
+    }
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include "AlignmentChain.hpp"
+#include "CLI11.hpp"
+
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <map>
+
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::uniform_int_distribution;
+using std::runtime_error;
+using std::mt19937;
+using std::function;
+using std::to_string;
+using std::string;
+using std::vector;
+using std::less;
+using std::map;
+using std::cerr;
+
+using liger2liger::AlignmentChains;
+using liger2liger::AlignmentChain;
+using liger2liger::ChainElement;
+using liger2liger::ReadOrder;
+
+
+/// Read names like ONT UUIDs, except for a fraction that look like other instruments' names. Each name is repeated
+/// n_alignments times, and the whole sequence is shuffled, as in a PAF that is not grouped by read.
+vector<string> generate_names(size_t n_reads, size_t n_alignments, double uuid_fraction){
+    mt19937 generator(0);
+    uniform_int_distribution<uint32_t> hex(0, 15);
+    uniform_int_distribution<uint32_t> percent(0, 99);
+
+    vector<string> names;
+
+    for (size_t i=0; i<n_reads; i++){
+        string name;
+
+        if (percent(generator) < uuid_fraction*100){
+            for (size_t j=0; j<36; j++){
+                name += (j == 8 or j == 13 or j == 18 or j == 23) ? '-' : "0123456789abcdef"[hex(generator)];
+            }
+
+            // Version 4, like the UUIDs written by basecallers
+            name[14] = '4';
+        }
+        else {
+            name = "m64011_190830_220126/" + to_string(i) + "/ccs";
+        }
+
+        for (size_t j=0; j<n_alignments; j++){
+            names.emplace_back(name);
+        }
+    }
+
+    std::shuffle(names.begin(), names.end(), generator);
+
+    return names;
+}
+
+
+double time_function(const string& name, size_t n_lookups, double reference_seconds, const function<uint64_t()>& f){
+    auto t0 = steady_clock::now();
+    auto checksum = f();
+    auto t1 = steady_clock::now();
+
+    double seconds = double(duration_cast<nanoseconds>(t1 - t0).count())/1e9;
+
+    cerr << name << '\t' << seconds << " s" << '\t' << double(n_lookups)/seconds/1e6 << " M lookups/s";
+
+    if (reference_seconds > 0){
+        cerr << '\t' << reference_seconds/seconds << "x";
+    }
+
+    cerr << '\t' << "checksum=" << checksum << '\n';
+
+    return seconds;
+}
+
+
+void benchmark(size_t n_reads, size_t n_alignments, double uuid_fraction){
+    auto names = generate_names(n_reads, n_alignments, uuid_fraction);
+
+    ChainElement e(0, 0, 1000, 0, 1000, 100000, 1000, 900, 1000, 60, false);
+
+    // The containers that AlignmentChains used before ReadNameTable and ChainStore, filled the way add_alignment did
+    map<string, vector<ChainElement>, less<> > map_chains;
+
+    double map_seconds = time_function("std_map", names.size(), 0, [&](){
+        for (auto& name: names){
+            auto result = map_chains.find(name);
+
+            if (result == map_chains.end()){
+                result = map_chains.emplace(name, vector<ChainElement>()).first;
+            }
+
+            result->second.emplace_back(e);
+        }
+
+        return map_chains.size();
+    });
+
+    AlignmentChains table_chains;
+
+    time_function("read_name_table", names.size(), map_seconds, [&](){
+        for (auto& name: names){
+            table_chains.add(name, e);
+        }
+
+        // Part of loading, since the elements of each read are only contiguous after this
+        table_chains.elements.group_by_read(table_chains.read_names.size());
+
+        return table_chains.read_names.size();
+    });
+
+    // Both must visit the same reads in the same order, with the same number of alignments each
+    auto map_iter = map_chains.begin();
+
+    table_chains.for_each_chain([&](string_view name, AlignmentChain& chain){
+        if (map_iter == map_chains.end() or name != map_iter->first or chain.size() != map_iter->second.size()){
+            throw runtime_error("ERROR: ReadNameTable iteration does not match std::map at read " + string(name));
+        }
+
+        map_iter++;
+    }, ReadOrder::by_name);
+
+    cerr << "Results identical" << '\n';
+
+    table_chains.read_names.write_stats(cerr);
+}
+
+
+int main(int argc, char* argv[]){
+    size_t n_reads = 1000000;
+    size_t n_alignments = 2;
+    double uuid_fraction = 1;
+
+    CLI::App app{"Microbenchmark of finding the chain of each alignment's read, comparing the std::map keyed by "
+                 "std::string that AlignmentChains used to hold to the ReadNameTable hash index"};
+
+    app.add_option(
+            "-n,--n_reads",
+            n_reads,
+            "How many distinct read names to generate");
+
+    app.add_option(
+            "-a,--n_alignments",
+            n_alignments,
+            "How many alignments to add for each read, in shuffled order");
+
+    app.add_option(
+            "-u,--uuid_fraction",
+            uuid_fraction,
+            "Fraction of read names that are UUIDs, with the rest stored as text in the arena");
+
+    CLI11_PARSE(app, argc, argv);
+
+    benchmark(n_reads, n_alignments, uuid_fraction);
+
+    return 0;
+}
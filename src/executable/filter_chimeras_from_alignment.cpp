@@ -1,4 +1,8 @@
 #include "AlignmentChain.hpp"
+#include "ParameterSweep.hpp"
+#include "ChainSegmenter.hpp"
+#include "BgzfLineReader.hpp"
+#include "Bam.hpp"
 #include "Filesystem.hpp"
 #include "CLI11.hpp"
 
@@ -8,6 +12,8 @@
 #include <string>
 #include <vector>
 #include <queue>
+#include <memory>
+#include <cstring>
 #include <cmath>
 
 using ghc::filesystem::create_directories;
@@ -19,14 +25,27 @@ using std::to_string;
 using std::string;
 using std::vector;
 using std::queue;
+using std::unique_ptr;
 using std::pair;
 using std::cerr;
 using std::cout;
 using std::abs;
 
+using liger2liger::BamRecordBatch;
+using liger2liger::BamWriter;
+using liger2liger::Bam;
 using liger2liger::AlignmentChains;
 using liger2liger::AlignmentChain;
+using liger2liger::PafSource;
+using liger2liger::SamSource;
+using liger2liger::BamSource;
 using liger2liger::ChainElement;
+using liger2liger::ReadOrder;
+using liger2liger::ParameterSweep;
+using liger2liger::SegmentationCosts;
+using liger2liger::ChainSegmenter;
+using liger2liger::parse_regions;
+using liger2liger::is_stream_path;
 
 
 bool chain_is_palindromic(const AlignmentChain& chain, const pair <size_t, size_t>& bounds){
@@ -40,12 +59,12 @@ bool chain_is_palindromic(const AlignmentChain& chain, const pair <size_t, size_
     uint32_t left_length = 0;
     uint32_t right_length = 0;
 
-    set<string> left_contigs;
-    set<string> right_contigs;
+    set<uint32_t> left_contigs;
+    set<uint32_t> right_contigs;
 
     // Iterate and accumulate chains for continuous strands. Chain must be sorted in order of query coordinates.
     for (size_t i=bounds.first; i < bounds.second; i++) {
-        const ChainElement& c = chain.chain[i];
+        auto c = chain[i];
 
         if (i == 0){
             prev_reversal = c.is_reverse;
@@ -71,12 +90,12 @@ bool chain_is_palindromic(const AlignmentChain& chain, const pair <size_t, size_
         if (n_strand_reversals == 0){
 //            left_length += c.query_stop - c.query_start;
             left_length += c.alignment_length;
-            left_contigs.emplace(c.ref_name);
+            left_contigs.emplace(c.contig_id);
         }
         if (n_strand_reversals == 1){
 //            right_length += c.query_stop - c.query_start;
             right_length += c.alignment_length;
-            right_contigs.emplace(c.ref_name);
+            right_contigs.emplace(c.contig_id);
         }
 
     }
@@ -97,105 +116,723 @@ bool chain_is_palindromic(const AlignmentChain& chain, const pair <size_t, size_
 }
 
 
-void filter_paf(path alignment_path){
-    AlignmentChains alignment_chains;
-
-    if (alignment_path.extension() == ".paf") {
-        alignment_chains.load_from_paf(alignment_path);
-    }
-    else if (alignment_path.extension() == ".bam") {
-        alignment_chains.load_from_bam(alignment_path);
-    }
-    else {
-        throw runtime_error("ERROR: cannot use '" + alignment_path.string() + "' file with '" + alignment_path.extension().string() + "' extension");
-    }
-
-    path chimer_id_path = alignment_path;
+class ChimerWriter {
+public:
+    ofstream chimer_id_file;
+    ofstream non_chimer_id_file;
+    ofstream non_chimer_lengths_file;
+    ofstream chimer_lengths_file;
+    ofstream chimer_subchains_lengths_file;
+    ofstream chimer_subchains_file;
+
+    // Only used to split chains if costs were given, in place of AlignmentChain::split
+    unique_ptr<ChainSegmenter> segmenter;
+    ofstream segment_costs_file;
+
+    /// Chains are split greedily at gaps unless segmentation_costs is given, in which case each one is split at its
+    /// lowest cost and that cost is written per read to <output_prefix>.segment_costs.txt
+    ChimerWriter(path output_prefix, const SegmentationCosts* segmentation_costs = nullptr);
+    void classify(string_view name, AlignmentChain& chain);
+
+    /// Same as above, for a chain that is already sorted, with the gaps of its whole store from
+    /// AlignmentChains::compute_gaps. These are only used by greedy splitting.
+    void classify(string_view name, AlignmentChain& chain, const vector<uint32_t>& store_gaps);
+
+    /// Same as above, also returning the subchains, and the original position of each element of the sorted chain
+    void classify(
+            string_view name,
+            AlignmentChain& chain,
+            vector<uint32_t>& order,
+            vector <pair <size_t, size_t> >& subchain_bounds,
+            const vector<uint32_t>* store_gaps = nullptr);
+};
+
+
+ChimerWriter::ChimerWriter(path output_prefix, const SegmentationCosts* segmentation_costs){
+    path chimer_id_path = output_prefix;
     chimer_id_path.replace_extension("chimeric_reads.txt");
-    ofstream chimer_id_file(chimer_id_path);
+    chimer_id_file.open(chimer_id_path);
 
-    path non_chimer_id_path = alignment_path;
+    path non_chimer_id_path = output_prefix;
     non_chimer_id_path.replace_extension("non_chimeric_reads.txt");
-    ofstream non_chimer_id_file(non_chimer_id_path);
+    non_chimer_id_file.open(non_chimer_id_path);
 
     cerr << "Writing chimeric reads to file: " << chimer_id_path << '\n';
     cerr << "Writing non-chimeric reads to file: " << non_chimer_id_path << '\n';
 
-    vector<size_t> non_chimer_lengths;
-    vector<size_t> chimer_lengths;
-
-    path non_chimer_lengths_path = alignment_path;
-    path chimer_lengths_path = alignment_path;
-    path chimer_subchains_lengths_path = alignment_path;
-    path chimer_subchains_path = alignment_path;
+    path non_chimer_lengths_path = output_prefix;
+    path chimer_lengths_path = output_prefix;
+    path chimer_subchains_lengths_path = output_prefix;
+    path chimer_subchains_path = output_prefix;
 
     non_chimer_lengths_path.replace_extension("non_chimer_lengths.txt");
     chimer_lengths_path.replace_extension("chimer_lengths.txt");
     chimer_subchains_lengths_path.replace_extension("chimer_subchains_lengths.txt");
     chimer_subchains_path.replace_extension("chimer_subchains.txt");
 
-    ofstream non_chimer_lengths_file(non_chimer_lengths_path);
-    ofstream chimer_lengths_file(chimer_lengths_path);
-    ofstream chimer_subchains_lengths_file(chimer_subchains_lengths_path);
-    ofstream chimer_subchains_file(chimer_subchains_path);
+    non_chimer_lengths_file.open(non_chimer_lengths_path);
+    chimer_lengths_file.open(chimer_lengths_path);
+    chimer_subchains_lengths_file.open(chimer_subchains_lengths_path);
+    chimer_subchains_file.open(chimer_subchains_path);
 
     cerr << "Writing chimeric lengths to file: " << chimer_lengths_path << '\n';
     cerr << "Writing non-chimeric lengths to file: " << non_chimer_lengths_path << '\n';
 
-    for (auto& [name, chain]: alignment_chains.chains) {
-        // Sort by order of occurrence in query (read) sequence
-        chain.sort_chain();
+    if (segmentation_costs != nullptr) {
+        segmenter = std::make_unique<ChainSegmenter>(*segmentation_costs);
+
+        path segment_costs_path = output_prefix;
+        segment_costs_path.replace_extension("segment_costs.txt");
+        segment_costs_file.open(segment_costs_path);
+
+        cerr << "Writing segmentation costs to file: " << segment_costs_path << '\n';
+    }
+}
+
+
+void ChimerWriter::classify(string_view name, AlignmentChain& chain){
+    vector<uint32_t> order;
+    vector <pair <size_t, size_t> > subchain_bounds;
+
+    classify(name, chain, order, subchain_bounds);
+}
+
+
+void ChimerWriter::classify(string_view name, AlignmentChain& chain, const vector<uint32_t>& store_gaps){
+    vector<uint32_t> order;
+    vector <pair <size_t, size_t> > subchain_bounds;
+
+    classify(name, chain, order, subchain_bounds, &store_gaps);
+}
+
+
+void ChimerWriter::classify(
+        string_view name,
+        AlignmentChain& chain,
+        vector<uint32_t>& order,
+        vector <pair <size_t, size_t> >& subchain_bounds,
+        const vector<uint32_t>* store_gaps){
+
+    // Sort by order of occurrence in query (read) sequence, which leaves an already sorted chain as it is
+    chain.sort_chain(order);
+
+    // Split at every large gap, or at the lowest cost, to find the index bounds of sub-chains
+    subchain_bounds.clear();
 
-        // Do recursive splitting to find the index bounds of sub-chains
-        set <pair <size_t, size_t> > subchain_bounds;
+    if (segmenter) {
+        auto cost = segmenter->split(chain, subchain_bounds);
+        segment_costs_file << name << '\t' << subchain_bounds.size() << '\t' << cost << '\n';
+    }
+    else if (store_gaps != nullptr) {
+        chain.split(*store_gaps, subchain_bounds);
+    }
+    else {
         chain.split(subchain_bounds);
+    }
 
-        if (subchain_bounds.size() > 1) {
-            vector<uint32_t> chain_lengths;
-            chain_lengths.resize(subchain_bounds.size());
+    if (subchain_bounds.size() > 1) {
+        // Iterate subchains created by splitting
+        for (auto &item: subchain_bounds) {
+            for (uint32_t i = item.first; i < item.second; i++) {
+                uint32_t length = abs(int32_t(chain[i].query_stop) - int32_t(chain[i].query_start));
+                chimer_subchains_lengths_file << length << '\n';
+            }
+        }
 
-            // Iterate subchains created by splitting
-            for (auto &item: subchain_bounds) {
-                for (uint32_t i = item.first; i < item.second; i++) {
-                    uint32_t length = abs(int32_t(chain.chain[i].query_stop) - int32_t(chain.chain[i].query_start));
-                    chimer_subchains_lengths_file << length << '\n';
-                }
+        chimer_lengths_file << chain[0].query_length << '\n';
+
+        chimer_id_file << name << '\n';
+
+        chimer_subchains_file << name << '\t';
+        for (auto& item: subchain_bounds) {
+            chimer_subchains_file << '(' << chain[item.first].query_start << ',' << chain[item.second - 1].query_stop << ")" << ',';
+        }
+        chimer_subchains_file << '\n';
+
+//        print_subchains(chain, subchain_bounds, name);
+    }
+    else{
+        non_chimer_id_file << name << '\n';
+        non_chimer_lengths_file << chain[0].query_length << '\n';
+    }
+}
+
+
+/// Plain, gzipped or BGZF PAF, or stdin which is assumed to be PAF as written by minimap2
+bool is_paf_path(path alignment_path){
+    if (alignment_path == "-" or alignment_path.extension() == ".paf") {
+        return true;
+    }
+
+    return alignment_path.extension() == ".gz" and alignment_path.stem().extension() == ".paf";
+}
+
+
+bool is_bam_path(path alignment_path){
+    return alignment_path.extension() == ".bam" or alignment_path.extension() == ".cram";
+}
+
+
+/// Plain, gzipped or BGZF SAM text
+bool is_sam_path(path alignment_path){
+    if (alignment_path.extension() == ".sam") {
+        return true;
+    }
+
+    return alignment_path.extension() == ".gz" and alignment_path.stem().extension() == ".sam";
+}
+
+
+/// Classify the reads of a BAM or CRAM whose records are grouped by read, in one pass, writing every record to
+/// output_bam_path as it goes. Records of chimeric reads are tagged with XC:Z:chimeric and the index of their subchain
+/// in XI:i, or left out if remove_chimeric.
+void write_classified_bam(
+        path alignment_path,
+        path output_prefix,
+        path output_bam_path,
+        size_t n_io_threads,
+        path reference_path,
+        bool remove_chimeric,
+        const SegmentationCosts* segmentation_costs){
+
+    // The writer compresses with the reader's thread pool, so it has to be closed first
+    Bam reader(alignment_path, n_io_threads, reference_path);
+    BamWriter bam_writer(output_bam_path, reader);
+
+    ChimerWriter writer(output_prefix, segmentation_costs);
+    AlignmentChains alignment_chains;
+
+    vector<uint32_t> order;
+    vector<int32_t> subchain_indexes;
+    vector <pair <size_t, size_t> > subchain_bounds;
+
+    const char* chimeric_label = "chimeric";
+
+    alignment_chains.for_read_in_grouped_bam(reader, [&](
+            string_view name,
+            AlignmentChain& chain,
+            const BamRecordBatch& records,
+            const vector<uint32_t>& record_indexes){
+
+        // Reads without usable alignments are not classified, as they would not be for any other input, but their
+        // records are still written
+        subchain_bounds.clear();
+
+        if (chain.size() > 0) {
+            writer.classify(name, chain, order, subchain_bounds);
+        }
+
+        bool is_chimeric = subchain_bounds.size() > 1;
+
+        if (is_chimeric and remove_chimeric) {
+            return;
+        }
+
+        // Element i of the sorted chain came from record record_indexes[order[i]]. Records that are not in the chain
+        // have no subchain.
+        subchain_indexes.assign(records.size, -1);
+
+        int32_t subchain_index = 0;
+
+        for (auto& item: subchain_bounds) {
+            for (size_t i=item.first; i<item.second; i++) {
+                subchain_indexes[record_indexes[order[i]]] = subchain_index;
             }
 
-            chimer_lengths_file << chain.chain[0].query_length << '\n';
+            subchain_index++;
+        }
+
+        for (size_t i=0; i<records.size; i++) {
+            auto record = records.records[i];
 
-            chimer_id_file << name << '\n';
+            if (is_chimeric) {
+                for (auto tag: {"XC", "XI"}) {
+                    auto existing = bam_aux_get(record, tag);
 
-            chimer_subchains_file << name << '\t';
-            for (auto& item: subchain_bounds) {
-                chimer_subchains_file << '(' << chain.chain[item.first].query_start << ',' << chain.chain[item.second - 1].query_stop << ")" << ',';
+                    if (existing != nullptr) {
+                        bam_aux_del(record, existing);
+                    }
+                }
+
+                bam_aux_append(record, "XC", 'Z', int(strlen(chimeric_label) + 1), (const uint8_t*)chimeric_label);
+
+                if (subchain_indexes[i] >= 0) {
+                    bam_aux_append(record, "XI", 'i', sizeof(int32_t), (const uint8_t*)&subchain_indexes[i]);
+                }
             }
-            chimer_subchains_file << '\n';
 
-//            print_subchains(chain, subchain_bounds, name);
+            bam_writer.write(record);
         }
-        else{
-            non_chimer_id_file << name << '\n';
-            non_chimer_lengths_file << chain.chain[0].query_length << '\n';
+    });
+}
+
+
+/// Write every chain, in the given order, to the outputs at output_prefix. With a sweep, only its table is written,
+/// with one row per setting, evaluated on n_threads.
+void classify_chains(
+        AlignmentChains& alignment_chains,
+        path output_prefix,
+        ReadOrder order,
+        ParameterSweep* sweep,
+        size_t n_threads,
+        const SegmentationCosts* segmentation_costs){
+    alignment_chains.read_names.write_stats(cerr);
+
+    if (sweep != nullptr) {
+        path sweep_path = output_prefix;
+        sweep_path.replace_extension("sweep.txt");
+
+        ofstream sweep_file(sweep_path);
+
+        if (not sweep_file.good()) {
+            throw runtime_error("ERROR: could not write file: " + sweep_path.string());
         }
+
+        cerr << "Evaluating " << sweep->size() << " settings, writing to file: " << sweep_path << '\n';
+
+        sweep->evaluate(alignment_chains, n_threads);
+        sweep->write_table(sweep_file);
+
+        return;
+    }
+
+    ChimerWriter writer(output_prefix, segmentation_costs);
+
+    if (segmentation_costs != nullptr) {
+        alignment_chains.for_each_chain([&](string_view name, AlignmentChain& chain){
+            writer.classify(name, chain);
+        }, order);
+
+        return;
+    }
+
+    // Every chain is sorted first, so that the gaps of all of them can be computed in one batch
+    alignment_chains.for_each_chain([&](string_view, AlignmentChain& chain){
+        chain.sort_chain();
+    }, ReadOrder::first_seen);
+
+    vector<uint32_t> gaps;
+    alignment_chains.compute_gaps(gaps);
+
+    alignment_chains.for_each_chain([&](string_view name, AlignmentChain& chain){
+        writer.classify(name, chain, gaps);
+    }, order);
+}
+
+
+/// Load and classify every alignment of one of the sources in AlignmentSource.hpp, which is resolved at compile time
+template<class Source> void classify_source(
+        Source& source,
+        path output_prefix,
+        ReadOrder order,
+        ParameterSweep* sweep,
+        size_t n_threads,
+        const SegmentationCosts* segmentation_costs){
+
+    AlignmentChains alignment_chains;
+    alignment_chains.load(source);
+
+    classify_chains(alignment_chains, output_prefix, order, sweep, n_threads, segmentation_costs);
+}
+
+
+void filter_paf(
+        path alignment_path,
+        path output_prefix,
+        bool use_mmap,
+        size_t n_threads,
+        size_t n_io_threads,
+        bool streaming,
+        bool input_order,
+        const string& regions,
+        bool include_linked,
+        path reference_path,
+        size_t max_memory,
+        bool use_sa_tags,
+        bool stdin_is_sam,
+        path output_bam_path,
+        bool remove_chimeric,
+        const vector<uint32_t>& sweep_min_qualities,
+        const vector<uint32_t>& sweep_gap_penalties,
+        const vector<uint32_t>& sweep_max_gaps,
+        const string& segmentation,
+        const SegmentationCosts& costs){
+
+    AlignmentChains alignment_chains;
+
+    if (n_io_threads == 0) {
+        n_io_threads = n_threads;
+    }
+
+    bool is_sam = is_sam_path(alignment_path) or (alignment_path == "-" and stdin_is_sam);
+    bool is_paf = is_paf_path(alignment_path) and not is_sam;
+
+    if (output_prefix.empty()) {
+        if (alignment_path == "-") {
+            throw runtime_error("ERROR: an output prefix must be provided when reading from stdin");
+        }
+
+        // Outputs are named by replacing the extension, and ".paf.gz" should become ".paf" first
+        output_prefix = alignment_path;
+
+        if (output_prefix.extension() == ".gz") {
+            output_prefix.replace_extension("");
+        }
+    }
+
+    if (not regions.empty() and not is_bam_path(alignment_path)) {
+        throw runtime_error("ERROR: regions can only be used with indexed BAM or CRAM input, not: " + alignment_path.string());
+    }
+
+    if (not reference_path.empty() and alignment_path.extension() != ".cram") {
+        throw runtime_error("ERROR: a reference can only be used with CRAM input, not: " + alignment_path.string());
+    }
+
+    bool use_sweep = not (sweep_min_qualities.empty() and sweep_gap_penalties.empty() and sweep_max_gaps.empty());
+
+    // Parameters that aren't swept keep the values that every other mode uses
+    ParameterSweep sweep(
+            sweep_min_qualities.empty() ? vector<uint32_t>{AlignmentChains::min_quality} : sweep_min_qualities,
+            sweep_gap_penalties.empty() ? vector<uint32_t>{AlignmentChain::gap_penalty} : sweep_gap_penalties,
+            sweep_max_gaps.empty() ? vector<uint32_t>{AlignmentChain::max_gap} : sweep_max_gaps);
+
+    if (use_sweep and (streaming or max_memory > 0 or use_sa_tags or not output_bam_path.empty())) {
+        throw runtime_error("ERROR: a parameter sweep needs every chain loaded at once, so it can't be combined with "
+                            "streaming, a memory limit, SA tag mode or BAM output");
+    }
+
+    if (segmentation != "greedy" and segmentation != "dp") {
+        throw runtime_error("ERROR: segmentation must be 'greedy' or 'dp', not: " + segmentation);
+    }
+
+    if (use_sweep and segmentation == "dp") {
+        throw runtime_error("ERROR: a parameter sweep only evaluates greedy segmentation");
+    }
+
+    auto segmentation_costs = (segmentation == "dp") ? &costs : nullptr;
+
+    if (not output_bam_path.empty()) {
+        if (not is_bam_path(alignment_path) or not regions.empty() or max_memory > 0 or use_sa_tags) {
+            throw runtime_error("ERROR: BAM output requires BAM or CRAM input grouped by read, and can't be combined "
+                                "with regions, a memory limit or SA tag mode");
+        }
+
+        if (output_bam_path.extension() != ".bam") {
+            throw runtime_error("ERROR: output must be a .bam file: " + output_bam_path.string());
+        }
+
+        write_classified_bam(alignment_path, output_prefix, output_bam_path, n_io_threads, reference_path, remove_chimeric, segmentation_costs);
+
+        return;
+    }
+
+    if (remove_chimeric) {
+        throw runtime_error("ERROR: removing chimeric reads requires an output BAM");
+    }
+
+    if (use_sa_tags) {
+        if (not (is_bam_path(alignment_path) or is_sam) or not regions.empty() or max_memory > 0) {
+            throw runtime_error("ERROR: SA tag mode requires SAM, BAM or CRAM input, and can't be combined with regions "
+                                "or a memory limit");
+        }
+
+        // Each read is classified as soon as its primary record is read
+        ChimerWriter writer(output_prefix, segmentation_costs);
+
+        auto classify = [&](string_view name, AlignmentChain& chain){
+            writer.classify(name, chain);
+        };
+
+        if (is_sam) {
+            alignment_chains.for_read_in_sam_primary(alignment_path, n_io_threads, classify);
+        }
+        else {
+            alignment_chains.for_read_in_bam_primary(alignment_path, n_io_threads, reference_path, classify);
+        }
+
+        return;
+    }
+
+    if (max_memory > 0) {
+        if (not is_bam_path(alignment_path)) {
+            throw runtime_error("ERROR: a memory limit can only be used with BAM or CRAM input, not: " + alignment_path.string());
+        }
+
+        // Run files go next to the outputs, and are removed once every partition has been classified
+        path temp_directory = output_prefix;
+        temp_directory += "_partitions";
+
+        ChimerWriter writer(output_prefix, segmentation_costs);
+
+        alignment_chains.for_read_in_bam(
+                alignment_path,
+                n_io_threads,
+                parse_regions(regions),
+                include_linked,
+                reference_path,
+                max_memory*1024*1024,
+                temp_directory,
+                [&](string_view name, AlignmentChain& chain){
+            writer.classify(name, chain);
+        });
+
+        return;
+    }
+
+    if (streaming) {
+        if (not is_paf) {
+            throw runtime_error("ERROR: streaming mode is only available for PAF input, not: " + alignment_path.string());
+        }
+
+        // Each read is classified and written as soon as its last alignment has been parsed
+        ChimerWriter writer(output_prefix, segmentation_costs);
+
+        alignment_chains.for_read_in_paf(alignment_path, n_io_threads, [&](string_view name, AlignmentChain& chain){
+            writer.classify(name, chain);
+        });
+
+        return;
+    }
+
+    auto order = input_order ? ReadOrder::first_seen : ReadOrder::by_name;
+    auto sweep_settings = use_sweep ? &sweep : nullptr;
+
+    if (is_paf and is_stream_path(alignment_path)) {
+        PafSource source(alignment_path, n_io_threads);
+        classify_source(source, output_prefix, order, sweep_settings, n_threads, segmentation_costs);
+    }
+    else if (is_paf) {
+        if (n_threads > 1) {
+            alignment_chains.load_from_paf_parallel(alignment_path, n_threads);
+        }
+        else if (use_mmap) {
+            alignment_chains.load_from_paf_mmap(alignment_path);
+        }
+        else {
+            alignment_chains.load_from_paf(alignment_path);
+        }
+
+        classify_chains(alignment_chains, output_prefix, order, sweep_settings, n_threads, segmentation_costs);
+    }
+    else if (is_sam) {
+        SamSource source(alignment_path, n_io_threads);
+        classify_source(source, output_prefix, order, sweep_settings, n_threads, segmentation_costs);
+    }
+    else if (is_bam_path(alignment_path) and regions.empty()) {
+        // Records are converted on n_threads while the pool decompresses, if there is more than one
+        BamSource source(alignment_path, n_io_threads, reference_path, (n_threads > 1) ? n_threads : 0);
+        classify_source(source, output_prefix, order, sweep_settings, n_threads, segmentation_costs);
+    }
+    else if (is_bam_path(alignment_path)) {
+        alignment_chains.load_from_bam(alignment_path, n_io_threads, parse_regions(regions), include_linked, reference_path);
+        classify_chains(alignment_chains, output_prefix, order, sweep_settings, n_threads, segmentation_costs);
+    }
+    else {
+        throw runtime_error("ERROR: cannot use '" + alignment_path.string() + "' file with '" + alignment_path.extension().string() + "' extension");
     }
 }
 
 
 int main(int argc, char* argv[]){
     path paf_path;
+    path output_prefix;
+    bool use_mmap = false;
+    size_t n_threads = 1;
+    size_t n_io_threads = 0;
+    bool streaming = false;
+    bool input_order = false;
+    string regions;
+    bool include_linked = false;
+    path reference_path;
+    size_t max_memory = 0;
+    bool use_sa_tags = false;
+    bool stdin_is_sam = false;
+    path output_bam_path;
+    bool remove_chimeric = false;
+    vector<uint32_t> sweep_min_qualities;
+    vector<uint32_t> sweep_gap_penalties;
+    vector<uint32_t> sweep_max_gaps;
+    string segmentation = "greedy";
+    SegmentationCosts costs;
 
     CLI::App app{"App description"};
 
     app.add_option(
             "-i,--alignment_path",
             paf_path,
-            "File path of PAF or BAM file containing alignments to some reference")
+            "File path of PAF, SAM, BAM or CRAM file containing alignments to some reference. PAF and SAM may be gzipped "
+            "or bgzipped, or '-' to read PAF (or SAM, with --sam) from stdin")
             ->required();
 
+    app.add_option(
+            "-o,--output_prefix",
+            output_prefix,
+            "Prefix for output files, which is required when reading from stdin. By default outputs are written next "
+            "to the input file");
+
+    app.add_flag(
+            "--mmap",
+            use_mmap,
+            "Memory map PAF input and parse it in place, instead of reading it line by line");
+
+    app.add_option(
+            "-t,--threads",
+            n_threads,
+            "Number of threads to use for parsing uncompressed PAF input (more than 1 implies --mmap), converting BAM "
+            "or CRAM records, and evaluating a parameter sweep");
+
+    app.add_option(
+            "--io_threads",
+            n_io_threads,
+            "Number of threads to use for decompressing BGZF, BAM or CRAM input, and compressing --output_bam "
+            "(default: same as --threads)");
+
+    app.add_flag(
+            "--sam",
+            stdin_is_sam,
+            "Read stdin as SAM text instead of PAF, e.g. to pipe in aligner output directly");
+
+    app.add_flag(
+            "--streaming",
+            streaming,
+            "Classify each read as soon as its alignments have been parsed, instead of loading the whole file first. "
+            "Requires a PAF in which all alignments of a read are adjacent, as written by minimap2. Reads are "
+            "written in input order rather than sorted by name");
+
+    app.add_flag(
+            "--input_order",
+            input_order,
+            "Write reads in order of their first alignment in the input, instead of sorted by name");
+
+    app.add_option(
+            "-r,--regions",
+            regions,
+            "Only evaluate alignments overlapping these regions, given as a .bed file or a comma separated list like "
+            "chr1,chr2:1000-2000 (1-based, inclusive). Requires BAM input with a .bai or .csi index, or CRAM "
+            "with a .crai index, and only the blocks covering the regions are decompressed");
+
+    app.add_flag(
+            "--linked",
+            include_linked,
+            "With --regions, also load the supplementary alignments (from SA tags) and mates of reads that overlap a "
+            "region, wherever they are, so that their chains are complete");
+
+    app.add_option(
+            "--reference",
+            reference_path,
+            "FASTA that CRAM input was compressed against, if it can't be found through the CRAM header or REF_PATH. "
+            "Only names, flags, positions, MAPQ and CIGAR are decoded, so sequences are never reconstructed from it");
+
+    app.add_option(
+            "--max_memory",
+            max_memory,
+            "Memory limit in MB for BAM or CRAM input, which need not be grouped by read. Alignments are spilled to "
+            "temporary files next to the outputs, which are grouped and classified one part at a time. Reads are "
+            "written sorted by name within each part, rather than overall");
+
+    app.add_flag(
+            "--sa_tags",
+            use_sa_tags,
+            "For SAM, BAM or CRAM input, build each read's chain from its primary record and the supplementary alignments "
+            "listed in its SA tag, skipping all other records. Input need not be grouped by read, and reads are written "
+            "in input order. Secondary alignments are not used");
+
+    app.add_option(
+            "--output_bam",
+            output_bam_path,
+            "Also write the input records to this BAM, with the records of chimeric reads tagged XC:Z:chimeric and "
+            "XI:i:<subchain index>. Requires BAM or CRAM input in which each read's records are adjacent, e.g. sorted "
+            "by name, which is read once. --io_threads are shared between decompression and compression");
+
+    app.add_flag(
+            "--remove_chimeric",
+            remove_chimeric,
+            "With --output_bam, leave chimeric reads out of it instead of tagging them");
+
+    app.add_option(
+            "--sweep_min_quality",
+            sweep_min_qualities,
+            "Comma separated map qualities to evaluate in a parameter sweep, which loads the input once and writes the "
+            "number of chimers, subchains and N50s at every combination of swept values to <output_prefix>.sweep.txt "
+            "instead of the usual outputs. Alignments with map quality at or below a value are ignored at that "
+            "setting, and values can't be below the default of 5")
+            ->delimiter(',');
+
+    app.add_option(
+            "--sweep_gap_penalty",
+            sweep_gap_penalties,
+            "Comma separated gap penalties to evaluate in a parameter sweep, added to the gap whenever a chain jumps "
+            "between contigs (default 5000)")
+            ->delimiter(',');
+
+    app.add_option(
+            "--sweep_max_gap",
+            sweep_max_gaps,
+            "Comma separated max gaps to evaluate in a parameter sweep, above which a gap splits a chain (default "
+            "50000)")
+            ->delimiter(',');
+
+    app.add_option(
+            "--segmentation",
+            segmentation,
+            "How chains are split into subchains: 'greedy' splits at every gap above 50000 bases, and 'dp' finds the "
+            "split with the lowest total of the costs below, which also writes each read's number of subchains and cost "
+            "to <output_prefix>.segment_costs.txt. At the default costs both give the same subchains");
+
+    app.add_option(
+            "--split_cost",
+            costs.split_cost,
+            "With --segmentation dp, cost of each subchain beyond the first (default 50000)");
+
+    app.add_option(
+            "--contig_jump_cost",
+            costs.contig_jump_cost,
+            "With --segmentation dp, cost added to the gap whenever a chain jumps between contigs (default 5000)");
+
+    app.add_option(
+            "--strand_flip_cost",
+            costs.strand_flip_cost,
+            "With --segmentation dp, cost of joining neighbouring alignments on opposite strands (default 0)");
+
+    app.add_option(
+            "--overlap_cost",
+            costs.overlap_cost,
+            "With --segmentation dp, cost per read base that neighbouring alignments in a subchain both cover (default 0)");
+
+    app.add_option(
+            "--min_segment_bases",
+            costs.min_segment_bases,
+            "With --segmentation dp, subchains with fewer aligned read bases than this cost --short_segment_cost "
+            "(default 0)");
+
+    app.add_option(
+            "--short_segment_cost",
+            costs.short_segment_cost,
+            "With --segmentation dp, cost of each subchain shorter than --min_segment_bases (default 0)");
+
     CLI11_PARSE(app, argc, argv);
 
-    filter_paf(paf_path);
+    filter_paf(
+            paf_path,
+            output_prefix,
+            use_mmap,
+            n_threads,
+            n_io_threads,
+            streaming,
+            input_order,
+            regions,
+            include_linked,
+            reference_path,
+            max_memory,
+            use_sa_tags,
+            stdin_is_sam,
+            output_bam_path,
+            remove_chimeric,
+            sweep_min_qualities,
+            sweep_gap_penalties,
+            sweep_max_gaps,
+            segmentation,
+            costs);
 
     return 0;
 }
@@ -0,0 +1,166 @@
+#include "AlignmentChain.hpp"
+#include "DelimiterScanner.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <set>
+
+using std::runtime_error;
+using std::mt19937;
+using std::string;
+using std::vector;
+using std::pair;
+using std::set;
+using std::cerr;
+
+using liger2liger::get_supported_simd_level;
+using liger2liger::set_simd_level;
+using liger2liger::AlignmentChains;
+using liger2liger::AlignmentChain;
+using liger2liger::ChainElement;
+using liger2liger::SimdLevel;
+
+
+/// The recursive split that AlignmentChain::split replaced: find the largest gap in the bounds, split there if it is
+/// larger than max_gap, and recur on both sides
+void recursive_split(const AlignmentChain& chain, set<pair<size_t, size_t> >& subchain_bounds, pair<size_t, size_t> bounds) {
+    if (subchain_bounds.empty()) {
+        bounds = {0, chain.size()};
+        subchain_bounds.emplace(bounds);
+    }
+
+    uint32_t longest_gap = 0;
+    size_t gap_index = 0;
+
+    for (size_t i=bounds.first; i + 1 < bounds.second; i++) {
+        auto gap = chain.compute_distance(i, i + 1);
+
+        if (gap > longest_gap) {
+            longest_gap = gap;
+            gap_index = i + 1;
+        }
+    }
+
+    if (longest_gap > AlignmentChain::max_gap) {
+        subchain_bounds.erase(bounds);
+
+        pair<size_t, size_t> left = {bounds.first, gap_index};
+        pair<size_t, size_t> right = {gap_index, bounds.second};
+
+        subchain_bounds.emplace(left);
+        subchain_bounds.emplace(right);
+
+        recursive_split(chain, subchain_bounds, left);
+        recursive_split(chain, subchain_bounds, right);
+    }
+}
+
+
+/// Fill chains with n_reads reads of random alignments. Positions and lengths are rounded to multiples of step, so that
+/// a small step gives gaps of every size, and a large one gives many gaps of exactly max_gap, which must not be split.
+void add_random_reads(AlignmentChains& chains, mt19937& rng, size_t n_reads, size_t max_length, uint32_t step) {
+    uint32_t n_contigs = 1 + rng()%3;
+
+    for (size_t r=0; r<n_reads; r++) {
+        string name = "read_" + std::to_string(r);
+        size_t n = 1 + rng()%max_length;
+
+        for (size_t i=0; i<n; i++) {
+            uint32_t contig = rng()%n_contigs;
+            uint32_t contig_length = 200000 + contig*100000;
+
+            uint32_t ref_start = (rng()%(contig_length - 20000))/step*step;
+            uint32_t query_start = (rng()%100000)/step*step;
+            uint32_t length = 1000 + (rng()%15000)/step*step;
+
+            ChainElement e(
+                    chains.contigs.get_id("contig_" + std::to_string(contig), contig_length),
+                    ref_start,
+                    ref_start + length,
+                    query_start,
+                    query_start + length,
+                    contig_length,
+                    120000,
+                    length,
+                    length,
+                    60,
+                    rng()%2);
+
+            chains.add(name, e);
+        }
+    }
+}
+
+
+/// Split random chains with the recursive split and with both forms of AlignmentChain::split, which must all give the
+/// same subchains. Returns the number of chains that were split.
+size_t test_random_chains(size_t n_trials, uint32_t seed) {
+    mt19937 rng(seed);
+    size_t n_split = 0;
+
+    vector<uint32_t> gaps;
+    vector<pair<size_t, size_t> > bounds;
+    vector<pair<size_t, size_t> > batch_bounds;
+
+    for (size_t trial=0; trial<n_trials; trial++) {
+        AlignmentChains chains;
+
+        // Mostly short chains like most reads, with some long ones like repeat-rich reads
+        size_t max_length = (trial%10 == 0) ? 400 : 12;
+        uint32_t step = (trial%3 == 0) ? 10000 : 1;
+
+        add_random_reads(chains, rng, 1 + rng()%4, max_length, step);
+
+        for (uint32_t id=0; id<chains.read_names.size(); id++) {
+            auto chain = chains.get_chain(id);
+            chain.sort_chain();
+        }
+
+        chains.compute_gaps(gaps);
+
+        for (uint32_t id=0; id<chains.read_names.size(); id++) {
+            auto chain = chains.get_chain(id);
+
+            set<pair<size_t, size_t> > expected;
+            recursive_split(chain, expected, {0, 0});
+
+            chain.split(bounds);
+            chain.split(gaps, batch_bounds);
+
+            vector<pair<size_t, size_t> > expected_bounds(expected.begin(), expected.end());
+
+            if (bounds != expected_bounds or batch_bounds != expected_bounds) {
+                throw runtime_error("ERROR: subchains differ from recursive split in trial " + std::to_string(trial) +
+                                    " with seed " + std::to_string(seed));
+            }
+
+            n_split += (bounds.size() > 1);
+        }
+    }
+
+    return n_split;
+}
+
+
+int main(){
+    size_t n_trials = 20000;
+
+    // Every gap kernel that this CPU supports must give the same subchains
+    vector<SimdLevel> levels = {SimdLevel::scalar};
+
+    if (get_supported_simd_level() != SimdLevel::scalar) {
+        levels.emplace_back(get_supported_simd_level());
+    }
+
+    for (auto level: levels) {
+        set_simd_level(level);
+
+        auto n_split = test_random_chains(n_trials, 7);
+
+        cerr << "PASS " << liger2liger::to_string(level) << ": " << n_trials << " trials, " << n_split << " chains split" << '\n';
+    }
+
+    return 0;
+}